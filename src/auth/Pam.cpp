@@ -143,7 +143,7 @@ void CPam::waitForInput() {
     m_bBlockInput                          = false;
     m_sConversationState.waitingForPamAuth = false;
     m_sConversationState.inputRequested    = true;
-    m_sConversationState.inputSubmittedCondition.wait(lk, [this] { return !m_sConversationState.inputRequested || g_pHyprlock->m_bTerminate; });
+    m_sConversationState.inputSubmittedCondition.wait(lk, [this] { return !m_sConversationState.inputRequested || m_bTerminated || g_pHyprlock->m_bTerminate; });
     m_bBlockInput = true;
 }
 
@@ -172,6 +172,12 @@ bool CPam::checkWaiting() {
 }
 
 void CPam::terminate() {
+    {
+        // the daemon terminates auth without exiting, so m_bTerminate can't wake the auth thread
+        std::lock_guard<std::mutex> lg(m_sConversationState.inputMutex);
+        m_bTerminated = true;
+    }
+
     m_sConversationState.inputSubmittedCondition.notify_all();
     if (m_thread.joinable())
         m_thread.join();
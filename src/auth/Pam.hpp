@@ -45,6 +45,7 @@ class CPam : public IAuthImplementation {
     SPamConversationState m_sConversationState;
 
     bool                  m_bBlockInput = true;
+    bool                  m_bTerminated = false; // guarded by inputMutex
 
     std::string           m_sPamModule;
 
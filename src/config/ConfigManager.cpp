@@ -217,9 +217,12 @@ void CConfigManager::init() {
     m_config.addConfigValue("general:ignore_empty_input", Hyprlang::INT{0});
     m_config.addConfigValue("general:immediate_render", Hyprlang::INT{0});
     m_config.addConfigValue("general:fractional_scaling", Hyprlang::INT{2});
-    m_config.addConfigValue("general:screencopy_mode", Hyprlang::INT{0});
+    m_config.addConfigValue("general:screencopy_mode", Hyprlang::INT{2}); // 0 dma, 1 shm, 2 pick by measured cost
+    m_config.addConfigValue("general:screencopy_timeout", Hyprlang::INT{0}); // per output in ms, 0 adapts to earlier captures
     m_config.addConfigValue("general:fail_timeout", Hyprlang::INT{2000});
     m_config.addConfigValue("general:hide_text_input_field", Hyprlang::INT{0});
+    m_config.addConfigValue("general:background_cache", Hyprlang::INT{0});
+    m_config.addConfigValue("general:blur_engine", Hyprlang::INT{0}); // 0 kawase, 1 gaussian on compute shaders (GLES 3.1)
 
     m_config.addConfigValue("auth:pam:enabled", Hyprlang::INT{1});
     m_config.addConfigValue("auth:pam:module", Hyprlang::STRING{"hyprlock"});
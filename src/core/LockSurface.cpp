@@ -7,6 +7,10 @@
 #include "../renderer/Renderer.hpp"
 
 CSessionLockSurface::~CSessionLockSurface() {
+    // the daemon creates new surfaces for every lock
+    if (eglSurface && g_pEGL)
+        eglDestroySurface(g_pEGL->eglDisplay, eglSurface);
+
     if (eglWindow)
         wl_egl_window_destroy(eglWindow);
 }
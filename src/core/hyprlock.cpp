@@ -8,9 +8,12 @@
 #include "Egl.hpp"
 #include <chrono>
 #include <hyprutils/memory/UniquePtr.hpp>
+#include <sys/eventfd.h>
 #include <sys/wait.h>
 #include <sys/poll.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <fcntl.h>
 #include <csignal>
 #include <unistd.h>
@@ -37,7 +40,7 @@ static void setMallocThreshold() {
 #endif
 }
 
-CHyprlock::CHyprlock(const std::string& wlDisplay, const bool immediateRender, const int graceSeconds) {
+CHyprlock::CHyprlock(const std::string& wlDisplay, const bool immediateRender, const int graceSeconds, const bool daemon) {
     setMallocThreshold();
 
     m_sWaylandState.display = wl_display_connect(wlDisplay.empty() ? nullptr : wlDisplay.c_str());
@@ -53,6 +56,9 @@ CHyprlock::CHyprlock(const std::string& wlDisplay, const bool immediateRender, c
     static const auto IMMEDIATERENDER = g_pConfigManager->getValue<Hyprlang::INT>("general:immediate_render");
     m_bImmediateRender                = immediateRender || *IMMEDIATERENDER;
 
+    m_bDaemon                   = daemon;
+    m_sDaemonState.graceSeconds = graceSeconds;
+
     const auto CURRENTDESKTOP = getenv("XDG_CURRENT_DESKTOP");
     const auto SZCURRENTD     = std::string{CURRENTDESKTOP ? CURRENTDESKTOP : ""};
     m_sCurrentDesktop         = SZCURRENTD;
@@ -93,6 +99,21 @@ static void handlePollTerminate(int sig) {
     ;
 }
 
+// the daemon's lockSignalFd, -1 if not running as a daemon
+static int lockSignalFd = -1;
+
+static void handleLockSignal(int sig) {
+    // The main thread may hold any lock right now, so only wake the poll thread
+    if (lockSignalFd >= 0) {
+        const int      SAVEDERRNO = errno;
+        const uint64_t ONE        = 1;
+        if (write(lockSignalFd, &ONE, sizeof(ONE)) < 0) {
+            // nothing we can do from here, the counter is only full after 2^64-2 signals anyway
+        }
+        errno = SAVEDERRNO;
+    }
+}
+
 static char* gbm_find_render_node(drmDevice* device) {
     drmDevice* devices[64];
     char*      render_node = nullptr;
@@ -322,18 +343,37 @@ void CHyprlock::run() {
     // gather info about monitors
     wl_display_roundtrip(m_sWaylandState.display);
 
+    // before any threads are running, so failing here can just exit
+    if (m_bDaemon && !openControlSocket())
+        exit(1);
+
     g_pRenderer = makeUnique<CRenderer>();
-    g_pAuth     = makeUnique<CAuth>();
-    g_pAuth->start();
+
+    if (m_bBenchmarkBlur) {
+        g_pRenderer->benchmarkBlur();
+        m_bTerminate = true;
+        g_pRenderer->asyncResourceGatherer->notify();
+        g_pRenderer->asyncResourceGatherer->await();
+        exit(0);
+    }
+
+    g_pAuth = makeUnique<CAuth>();
 
     Debug::log(LOG, "Running on {}", m_sCurrentDesktop);
 
-    if (!g_pHyprlock->m_bImmediateRender) {
+    // The daemon keeps everything up to here warm. Auth, screencopy and the lock itself happen per lock request.
+    if (!m_bDaemon)
+        g_pAuth->start();
+
+    if (!g_pHyprlock->m_bImmediateRender && !m_bDaemon) {
         // Gather background resources and screencopy frames before locking the screen.
         // We need to do this because as soon as we lock the screen, workspaces frames can no longer be captured. It either won't work at all, or we will capture hyprlock itself.
         // Bypass with --immediate-render (can cause the background first rendering a solid color and missing or inaccurate screencopy frames)
-        const auto MAXDELAYMS    = 2000; // 2 Seconds
-        const auto STARTGATHERTP = std::chrono::system_clock::now();
+        // Each screencopy frame has its own deadline (see CScreencopyFrame::deadlineMsFor), outputs that miss it fall back to `background:color`.
+        // This only caps the wait for everything else.
+        static const auto SCTIMEOUT     = g_pConfigManager->getValue<Hyprlang::INT>("general:screencopy_timeout");
+        const auto        MAXDELAYMS    = std::max<int64_t>(2000, *SCTIMEOUT);
+        const auto        STARTGATHERTP = std::chrono::system_clock::now();
 
         int        fdcount = 1;
         pollfd     pollfds[2];
@@ -352,9 +392,16 @@ void CHyprlock::run() {
         }
 
         while (!g_pRenderer->asyncResourceGatherer->gathered) {
+            // gatheredEventfd wakes us as soon as the gatherer is done, so only the deadlines are left to wait for
+            const auto SCDEADLINEMS = g_pRenderer->asyncResourceGatherer->expireScreencopyFrames();
+            auto       remainingMs =
+                std::max<int64_t>(0, MAXDELAYMS - std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - STARTGATHERTP).count());
+            if (SCDEADLINEMS >= 0)
+                remainingMs = std::min(remainingMs, SCDEADLINEMS);
+
             wl_display_flush(m_sWaylandState.display);
             if (wl_display_prepare_read(m_sWaylandState.display) == 0) {
-                if (poll(pollfds, fdcount, /* 100ms timeout */ 100) < 0) {
+                if (poll(pollfds, fdcount, remainingMs) < 0) {
                     RASSERT(errno == EINTR, "[core] Polling fds failed with {}", errno);
                     wl_display_cancel_read(m_sWaylandState.display);
                     continue;
@@ -366,7 +413,7 @@ void CHyprlock::run() {
                 wl_display_dispatch(m_sWaylandState.display);
             }
 
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - STARTGATHERTP).count() > MAXDELAYMS) {
+            if (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - STARTGATHERTP).count() >= MAXDELAYMS) {
                 Debug::log(WARN, "Gathering resources timed out after {} milliseconds. Backgrounds may be delayed and render `background:color` at first.", MAXDELAYMS);
                 break;
             }
@@ -377,7 +424,7 @@ void CHyprlock::run() {
     }
 
     // Failed to lock the session
-    if (!acquireSessionLock()) {
+    if (!m_bDaemon && !acquireSessionLock()) {
         m_sLoopState.timerEvent = true;
         m_sLoopState.timerCV.notify_all();
         g_pRenderer->asyncResourceGatherer->notify();
@@ -387,24 +434,47 @@ void CHyprlock::run() {
     }
 
     const auto fingerprintAuth = g_pAuth->getImpl(AUTH_IMPL_FINGERPRINT);
-    const auto dbusConn        = (fingerprintAuth) ? ((CFingerprint*)fingerprintAuth.get())->getConnection() : nullptr;
+    // the daemon starts auth for every lock, so the connection is picked up again in the loop
+    auto dbusConn = (fingerprintAuth) ? ((CFingerprint*)fingerprintAuth.get())->getConnection() : nullptr;
 
     registerSignalAction(SIGUSR1, handleUnlockSignal, SA_RESTART);
     registerSignalAction(SIGUSR2, handleForceUpdateSignal);
     registerSignalAction(SIGRTMIN, handlePollTerminate);
+    if (m_bDaemon) {
+        m_sDaemonState.lockSignalFd = CFileDescriptor{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)};
+        if (!m_sDaemonState.lockSignalFd.isValid())
+            Debug::log(ERR, "Failed to create the lock signal eventfd: {}", strerror(errno));
 
-    pollfd pollfds[2];
+        lockSignalFd = m_sDaemonState.lockSignalFd.get();
+        registerSignalAction(SIGRTMIN + 1, handleLockSignal, SA_RESTART);
+    }
+
+    pollfd pollfds[4];
     pollfds[0] = {
         .fd     = wl_display_get_fd(m_sWaylandState.display),
         .events = POLLIN,
     };
-    if (dbusConn) {
+    if (fingerprintAuth) {
         pollfds[1] = {
-            .fd     = dbusConn->getEventLoopPollData().fd,
+            .fd     = dbusConn ? dbusConn->getEventLoopPollData().fd : -1,
+            .events = POLLIN,
+        };
+    }
+    size_t       fdcount    = fingerprintAuth ? 2 : 1;
+    const size_t CONTROLIDX = fdcount;
+    if (m_sDaemonState.socket.isValid()) {
+        pollfds[fdcount++] = {
+            .fd     = m_sDaemonState.socket.get(),
+            .events = POLLIN,
+        };
+    }
+    const size_t LOCKSIGNALIDX = fdcount;
+    if (m_sDaemonState.lockSignalFd.isValid()) {
+        pollfds[fdcount++] = {
+            .fd     = m_sDaemonState.lockSignalFd.get(),
             .events = POLLIN,
         };
     }
-    size_t      fdcount = dbusConn ? 2 : 1;
 
     std::thread pollThr([this, &pollfds, fdcount]() {
         while (!m_bTerminate) {
@@ -465,7 +535,8 @@ void CHyprlock::run() {
     });
 
     m_sLoopState.event = true; // let it process once
-    g_pRenderer->startFadeIn();
+    if (!m_bDaemon)
+        g_pRenderer->startFadeIn();
 
     while (!m_bTerminate) {
         std::unique_lock lk(m_sLoopState.eventRequestMutex);
@@ -482,10 +553,31 @@ void CHyprlock::run() {
         wl_display_dispatch_pending(m_sWaylandState.display);
         wl_display_flush(m_sWaylandState.display);
 
+        // accept before the poll thread polls again, or it would wake up for the same connection
+        if (CONTROLIDX < fdcount && pollfds[CONTROLIDX].revents & POLLIN)
+            handleControlConnections();
+
+        if (LOCKSIGNALIDX < fdcount && pollfds[LOCKSIGNALIDX].revents & POLLIN) {
+            eventfd_t count = 0;
+            if (eventfd_read(m_sDaemonState.lockSignalFd.get(), &count) == 0) {
+                Debug::log(LOG, "Lock requested with a signal");
+                requestLock();
+            }
+        }
+
+        if (m_bDaemon && fingerprintAuth) {
+            const auto FINGERPRINT = g_pAuth->getImpl(AUTH_IMPL_FINGERPRINT);
+            const auto CONN        = FINGERPRINT ? ((CFingerprint*)FINGERPRINT.get())->getConnection() : nullptr;
+            if (CONN != dbusConn) {
+                dbusConn      = CONN;
+                pollfds[1].fd = CONN ? CONN->getEventLoopPollData().fd : -1;
+            }
+        }
+
         m_sLoopState.wlDispatched = true;
         m_sLoopState.wlDispatchCV.notify_all();
 
-        if (pollfds[1].revents & POLLIN /* dbus */) {
+        if (fingerprintAuth && pollfds[1].revents & POLLIN /* dbus */) {
             while (dbusConn && dbusConn->processPendingEvent()) {
                 ;
             }
@@ -513,6 +605,8 @@ void CHyprlock::run() {
         m_sLoopState.timersMutex.unlock();
 
         passed.clear();
+
+        checkLockRequest();
     }
 
     const auto DPY = m_sWaylandState.display;
@@ -531,6 +625,9 @@ void CHyprlock::run() {
 
     wl_display_disconnect(DPY);
 
+    if (!m_sDaemonState.socketPath.empty())
+        unlink(m_sDaemonState.socketPath.c_str());
+
     pthread_kill(pollThr.native_handle(), SIGRTMIN);
 
     g_pAuth->terminate();
@@ -791,7 +888,7 @@ bool CHyprlock::acquireSessionLock() {
     wl_display_roundtrip(m_sWaylandState.display);
 
     // recieved finished right away (probably already locked)
-    if (m_bTerminate)
+    if (m_bTerminate || !m_sLockState.lock)
         return false;
 
     m_lockAquired = true;
@@ -829,10 +926,16 @@ void CHyprlock::releaseSessionLock() {
     m_sLockState.lock->sendUnlockAndDestroy();
     m_sLockState.lock = nullptr;
 
-    Debug::log(LOG, "Unlocked, exiting!");
+    m_bLocked = false;
 
-    m_bTerminate = true;
-    m_bLocked    = false;
+    if (m_bDaemon) {
+        Debug::log(LOG, "Unlocked, going back to idle");
+        // we are inside a frame of one of the lock surfaces, tear them down after it
+        addTimer(std::chrono::milliseconds(0), [](auto, auto) { g_pHyprlock->endSession(); }, nullptr);
+    } else {
+        Debug::log(LOG, "Unlocked, exiting!");
+        m_bTerminate = true;
+    }
 
     wl_display_roundtrip(m_sWaylandState.display);
 }
@@ -860,7 +963,158 @@ void CHyprlock::onLockFinished() {
         m_sLockState.lock.reset();
 
     m_sLockState.lock = nullptr;
-    m_bTerminate      = true;
+    m_bLocked         = false;
+
+    if (m_bDaemon)
+        addTimer(std::chrono::milliseconds(0), [](auto, auto) { g_pHyprlock->endSession(); }, nullptr);
+    else
+        m_bTerminate = true;
+}
+
+void CHyprlock::requestLock() {
+    if (!m_bDaemon)
+        return;
+
+    if (m_sDaemonState.lockRequested || m_sLockState.lock || m_lockAquired) {
+        Debug::log(LOG, "Lock requested, but we are already locking");
+        return;
+    }
+
+    Debug::log(LOG, "Lock requested");
+
+    m_sDaemonState.lockRequested = true;
+
+    if (m_sDaemonState.graceSeconds > 0)
+        m_tGraceEnds = std::chrono::system_clock::now() + std::chrono::seconds(m_sDaemonState.graceSeconds);
+
+    // the screen changed since the last lock, everything else is still warm
+    if (!m_bImmediateRender)
+        g_pRenderer->asyncResourceGatherer->recaptureScreencopy();
+
+    checkLockRequest();
+}
+
+void CHyprlock::checkLockRequest() {
+    if (!m_sDaemonState.lockRequested)
+        return;
+
+    if (!m_bImmediateRender && !g_pRenderer->asyncResourceGatherer->gathered) {
+        // -1 means all frames are in and the gather thread is about to set gathered
+        const auto NEXTDEADLINEMS = g_pRenderer->asyncResourceGatherer->expireScreencopyFrames();
+        addTimer(std::chrono::milliseconds(NEXTDEADLINEMS >= 0 ? NEXTDEADLINEMS : 1), [](auto, auto) { ; }, nullptr);
+
+        return;
+    }
+
+    m_sDaemonState.lockRequested = false;
+    lockSession();
+}
+
+void CHyprlock::lockSession() {
+    g_pAuth->start();
+
+    if (!acquireSessionLock()) {
+        Debug::log(ERR, "Failed to lock the session, staying idle");
+        endSession();
+        return;
+    }
+
+    g_pRenderer->startFadeIn();
+}
+
+void CHyprlock::endSession() {
+    m_lockAquired = false;
+
+    for (auto& o : m_vOutputs) {
+        g_pRenderer->removeWidgetsFor(o->m_ID);
+        o->m_sessionLockSurface.reset();
+    }
+
+    if (m_pKeyRepeatTimer) {
+        m_pKeyRepeatTimer->cancel();
+        m_pKeyRepeatTimer.reset();
+    }
+
+    m_vPressedKeys.clear();
+    m_sPasswordState = {};
+
+    // the next lock may be hours away
+    g_pRenderer->fbPool.trim();
+
+    // auth threads end with the lock, the next one gets fresh ones
+    g_pAuth->terminate();
+    g_pAuth = makeUnique<CAuth>();
+
+    Debug::log(LOG, "Idle, waiting for the next lock request");
+}
+
+bool CHyprlock::openControlSocket() {
+    const auto XDGRUNTIMEDIR = getenv("XDG_RUNTIME_DIR");
+    if (!XDGRUNTIMEDIR) {
+        Debug::log(CRIT, "XDG_RUNTIME_DIR not set!");
+        return false;
+    }
+
+    const auto  PATH = std::string{XDGRUNTIMEDIR} + "/hyprlock.sock";
+
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (PATH.size() >= sizeof(addr.sun_path)) {
+        Debug::log(CRIT, "Socket path {} is too long", PATH);
+        return false;
+    }
+
+    strncpy(addr.sun_path, PATH.c_str(), sizeof(addr.sun_path) - 1);
+
+    CFileDescriptor fd{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)};
+    if (!fd.isValid()) {
+        Debug::log(CRIT, "Failed to create the control socket: {}", strerror(errno));
+        return false;
+    }
+
+    // only remove the socket if nobody is listening on it anymore
+    if (CFileDescriptor probe{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)}; probe.isValid() && connect(probe.get(), (sockaddr*)&addr, sizeof(addr)) == 0) {
+        Debug::log(CRIT, "Another hyprlock daemon is listening on {}", PATH);
+        return false;
+    }
+
+    unlink(PATH.c_str());
+
+    if (bind(fd.get(), (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd.get(), 4) < 0) {
+        Debug::log(CRIT, "Failed to listen on {}: {}", PATH, strerror(errno));
+        return false;
+    }
+
+    m_sDaemonState.socket     = std::move(fd);
+    m_sDaemonState.socketPath = PATH;
+
+    Debug::log(LOG, "Daemon ready, send \"lock\" to {} or SIGRTMIN+1 to lock", PATH);
+    return true;
+}
+
+void CHyprlock::handleControlConnections() {
+    while (true) {
+        CFileDescriptor client{accept4(m_sDaemonState.socket.get(), nullptr, nullptr, SOCK_CLOEXEC)};
+        if (!client.isValid())
+            return;
+
+        // the request may trail the connection a little, don't let a stuck client block us
+        const timeval TIMEOUT = {.tv_sec = 0, .tv_usec = 100000};
+        setsockopt(client.get(), SOL_SOCKET, SO_RCVTIMEO, &TIMEOUT, sizeof(TIMEOUT));
+
+        char       buf[32] = {0};
+        const auto LEN     = read(client.get(), buf, sizeof(buf) - 1);
+        const auto REQUEST = std::string_view{buf, (size_t)std::max<ssize_t>(LEN, 0)}.substr(0, std::string_view{buf}.find_first_of("\r\n"));
+
+        std::string reply;
+        if (REQUEST == "lock") {
+            reply = m_sDaemonState.lockRequested || m_lockAquired ? "already locked\n" : "ok\n";
+            requestLock();
+        } else
+            reply = "unknown request\n";
+
+        if (write(client.get(), reply.c_str(), reply.size()) < 0)
+            Debug::log(WARN, "Failed to reply to a control connection");
+    }
 }
 
 SP<CCExtSessionLockManagerV1> CHyprlock::getSessionLockMgr() {
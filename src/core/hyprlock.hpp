@@ -16,6 +16,8 @@
 #include <condition_variable>
 #include <optional>
 
+#include <hyprutils/os/FileDescriptor.hpp>
+
 #include <xkbcommon/xkbcommon.h>
 #include <xkbcommon/xkbcommon-compose.h>
 
@@ -29,11 +31,14 @@ struct SDMABUFModifier {
 
 class CHyprlock {
   public:
-    CHyprlock(const std::string& wlDisplay, const bool immediateRender, const int gracePeriod);
+    CHyprlock(const std::string& wlDisplay, const bool immediateRender, const int gracePeriod, const bool daemon = false);
     ~CHyprlock();
 
     void                       run();
 
+    // daemon mode only, locks once the screencopy frames for this lock are in
+    void                       requestLock();
+
     void                       unlock();
     bool                       isUnlocked();
 
@@ -88,6 +93,8 @@ class CHyprlock {
     bool                             m_bCtrl     = false;
 
     bool                             m_bImmediateRender = false;
+    bool                             m_bDaemon          = false; // stay resident, lock on request and go back to idle after unlock
+    bool                             m_bBenchmarkBlur   = false;
 
     std::string                      m_sCurrentDesktop = "";
 
@@ -139,6 +146,20 @@ class CHyprlock {
         SP<CCExtSessionLockV1> lock = nullptr;
     } m_sLockState;
 
+    struct {
+        Hyprutils::OS::CFileDescriptor socket;
+        Hyprutils::OS::CFileDescriptor lockSignalFd; // eventfd, written by the SIGRTMIN+1 handler
+        std::string                    socketPath;
+        int                            graceSeconds  = 0;
+        bool                           lockRequested = false;
+    } m_sDaemonState;
+
+    void lockSession();
+    void endSession();
+    void checkLockRequest();
+    bool openControlSocket();
+    void handleControlConnections();
+
     struct {
         std::string passBuffer      = "";
         size_t      failedAttempts  = 0;
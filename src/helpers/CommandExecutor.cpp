@@ -0,0 +1,157 @@
+#include "CommandExecutor.hpp"
+#include "Log.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <optional>
+#include <poll.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+// nullopt if the command timed out
+static std::optional<std::string> runShell(const std::string& cmd, std::chrono::milliseconds timeout) {
+    int outPipe[2] = {-1, -1};
+    int errPipe[2] = {-1, -1};
+    if (pipe2(outPipe, O_CLOEXEC) < 0 || pipe2(errPipe, O_CLOEXEC) < 0) {
+        Debug::log(ERR, "Failed to create pipes for \"{}\": {}", cmd, strerror(errno));
+        for (int fd : {outPipe[0], outPipe[1], errPipe[0], errPipe[1]}) {
+            if (fd >= 0)
+                close(fd);
+        }
+        return "";
+    }
+
+    const pid_t PID = fork();
+    if (PID == 0) {
+        // own process group, so a timeout takes the whole pipeline down
+        setpgid(0, 0);
+        dup2(outPipe[1], STDOUT_FILENO);
+        dup2(errPipe[1], STDERR_FILENO);
+        execl("/bin/sh", "/bin/sh", "-c", cmd.c_str(), nullptr);
+        _exit(127);
+    }
+
+    close(outPipe[1]);
+    close(errPipe[1]);
+
+    if (PID < 0) {
+        Debug::log(ERR, "Failed to fork for \"{}\": {}", cmd, strerror(errno));
+        close(outPipe[0]);
+        close(errPipe[0]);
+        return "";
+    }
+
+    std::string stdOut, stdErr;
+    pollfd      fds[2]   = {{.fd = outPipe[0], .events = POLLIN, .revents = 0}, {.fd = errPipe[0], .events = POLLIN, .revents = 0}};
+    int         open     = 2;
+    bool        timedOut = false;
+    const auto  DEADLINE = std::chrono::steady_clock::now() + timeout;
+
+    while (open > 0) {
+        const auto LEFTMS = std::chrono::duration_cast<std::chrono::milliseconds>(DEADLINE - std::chrono::steady_clock::now()).count();
+        if (LEFTMS <= 0) {
+            timedOut = true;
+            break;
+        }
+
+        if (poll(fds, 2, LEFTMS) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (auto& pfd : fds) {
+            if (pfd.fd < 0 || !pfd.revents)
+                continue;
+
+            char          buf[4096];
+            const ssize_t LEN = read(pfd.fd, buf, sizeof(buf));
+            if (LEN > 0) {
+                (&pfd == &fds[0] ? stdOut : stdErr).append(buf, LEN);
+                continue;
+            }
+
+            if (LEN < 0 && errno == EINTR)
+                continue;
+
+            close(pfd.fd);
+            pfd.fd = -1;
+            open--;
+        }
+    }
+
+    for (const auto& pfd : fds) {
+        if (pfd.fd >= 0)
+            close(pfd.fd);
+    }
+
+    // closed pipes don't mean it exited, it may have closed them itself and kept running
+    bool reaped = false;
+    while (!timedOut) {
+        const pid_t RET = waitpid(PID, nullptr, WNOHANG);
+        if (RET == PID || (RET < 0 && errno != EINTR)) {
+            reaped = true;
+            break;
+        }
+
+        if (std::chrono::steady_clock::now() >= DEADLINE) {
+            timedOut = true;
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    if (timedOut) {
+        Debug::log(ERR, "Shell command \"{}\" timed out after {}ms, killing it", cmd, timeout.count());
+        kill(-PID, SIGKILL);
+    }
+
+    if (!reaped)
+        waitpid(PID, nullptr, 0);
+
+    if (!stdErr.empty())
+        Debug::log(ERR, "Shell command \"{}\" STDERR:\n{}", cmd, stdErr);
+
+    if (timedOut)
+        return std::nullopt;
+
+    return stdOut;
+}
+
+std::string CCommandExecutor::run(const std::string& cmd, std::chrono::milliseconds ttl, std::chrono::milliseconds timeout) {
+    std::unique_lock lk(mutex);
+
+    auto&            command = commands[cmd];
+
+    // someone else is already running it, take their output
+    if (command.running) {
+        cv.wait(lk, [&command] { return !command.running; });
+        return command.output;
+    }
+
+    if (command.finished.time_since_epoch().count() != 0 && std::chrono::steady_clock::now() - command.finished < ttl) {
+        Debug::log(TRACE, "Reusing the output of \"{}\"", cmd);
+        return command.output;
+    }
+
+    command.running = true;
+
+    lk.unlock();
+    const auto OUTPUT = runShell(cmd, timeout);
+    lk.lock();
+
+    command.running = false;
+    cv.notify_all();
+
+    // keep showing the last output, the next run might finish in time
+    if (!OUTPUT)
+        return command.output;
+
+    command.output   = *OUTPUT;
+    command.finished = std::chrono::steady_clock::now();
+
+    return command.output;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../defines.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Runs the shell commands of cmd[] labels.
+// The same command shows up once per monitor, so identical commands share a run while one is in flight,
+// and reuse its output for ttl after it finished.
+class CCommandExecutor {
+  public:
+    // Blocks until the output is available. Commands still running after timeout are killed,
+    // and the output of their last finished run is returned instead.
+    std::string run(const std::string& cmd, std::chrono::milliseconds ttl, std::chrono::milliseconds timeout);
+
+  private:
+    struct SCommand {
+        bool                                  running = false;
+        std::string                           output;
+        std::chrono::steady_clock::time_point finished;
+    };
+
+    std::mutex                                mutex;
+    std::condition_variable                   cv;
+    std::unordered_map<std::string, SCommand> commands;
+};
+
+inline UP<CCommandExecutor> g_pCommandExecutor = makeUnique<CCommandExecutor>();
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+// Bounded lock-free queue (Dmitry Vyukov's MPMC ring buffer).
+// Any number of threads may push and pop concurrently. Entries are moved in and out.
+template <typename T>
+class CLockFreeQueue {
+  public:
+    // capacity is rounded up to a power of two
+    explicit CLockFreeQueue(size_t capacity) : m_capacity(std::bit_ceil(std::max<size_t>(capacity, 2))), m_cells(std::make_unique<SCell[]>(m_capacity)) {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    CLockFreeQueue(const CLockFreeQueue&)            = delete;
+    CLockFreeQueue& operator=(const CLockFreeQueue&) = delete;
+
+    // returns false if the queue is full
+    bool push(T&& value) {
+        SCell* cell = nullptr;
+        size_t pos  = m_enqueuePos.load(std::memory_order_relaxed);
+
+        while (true) {
+            cell               = &m_cells[pos & (m_capacity - 1)];
+            const size_t   SEQ = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t DIF = (intptr_t)SEQ - (intptr_t)pos;
+
+            if (DIF == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (DIF < 0)
+                return false;
+            else
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+
+        cell->data.emplace(std::move(value));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // returns std::nullopt if the queue is empty
+    std::optional<T> pop() {
+        SCell* cell = nullptr;
+        size_t pos  = m_dequeuePos.load(std::memory_order_relaxed);
+
+        while (true) {
+            cell               = &m_cells[pos & (m_capacity - 1)];
+            const size_t   SEQ = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t DIF = (intptr_t)SEQ - (intptr_t)(pos + 1);
+
+            if (DIF == 0) {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (DIF < 0)
+                return std::nullopt;
+            else
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+
+        std::optional<T> result = std::move(cell->data);
+        cell->data.reset();
+        cell->sequence.store(pos + m_capacity, std::memory_order_release);
+        return result;
+    }
+
+    // pops up to max entries, returns how many were handed to fn
+    template <typename F>
+    size_t drain(F&& fn, size_t max = SIZE_MAX) {
+        size_t count = 0;
+        while (count < max) {
+            auto value = pop();
+            if (!value)
+                break;
+
+            fn(std::move(*value));
+            count++;
+        }
+
+        return count;
+    }
+
+  private:
+    struct SCell {
+        std::atomic<size_t> sequence = 0;
+        std::optional<T>    data;
+    };
+
+    const size_t             m_capacity;
+    std::unique_ptr<SCell[]> m_cells;
+
+    // keep producers and consumers off each others cache lines
+    alignas(64) std::atomic<size_t> m_enqueuePos = 0;
+    alignas(64) std::atomic<size_t> m_dequeuePos = 0;
+};
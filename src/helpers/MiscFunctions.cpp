@@ -6,6 +6,7 @@
 #include "Log.hpp"
 #include <hyprutils/string/String.hpp>
 #include <hyprutils/os/Process.hpp>
+#include <sys/mman.h>
 #include <unistd.h>
 
 using namespace Hyprutils::String;
@@ -104,31 +105,28 @@ int64_t configStringToInt(const std::string& VALUE) {
     return 0;
 }
 
-int createPoolFile(size_t size, std::string& name) {
-    const auto XDGRUNTIMEDIR = getenv("XDG_RUNTIME_DIR");
-    if (!XDGRUNTIMEDIR) {
-        Debug::log(CRIT, "XDG_RUNTIME_DIR not set!");
-        return -1;
-    }
+// Anonymous memory, nothing ends up on disk and nothing is left behind if we crash.
+// Sealed against shrinking so the compositor can't be made to fault on it.
+int createPoolFile(size_t size) {
+    int FD = memfd_create("hyprlock_sc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (FD < 0) {
+        Debug::log(WARN, "createPoolFile: memfd_create failed (errno {}), falling back to a temp file", errno);
 
-    name = std::string(XDGRUNTIMEDIR) + "/.hyprlock_sc_XXXXXX";
+        const auto XDGRUNTIMEDIR = getenv("XDG_RUNTIME_DIR");
+        if (!XDGRUNTIMEDIR) {
+            Debug::log(CRIT, "XDG_RUNTIME_DIR not set!");
+            return -1;
+        }
 
-    const auto FD = mkstemp((char*)name.c_str());
-    if (FD < 0) {
-        Debug::log(CRIT, "createPoolFile: fd < 0");
-        return -1;
-    }
-    // set cloexec
-    long flags = fcntl(FD, F_GETFD);
-    if (flags == -1) {
-        close(FD);
-        return -1;
-    }
+        std::string name = std::string(XDGRUNTIMEDIR) + "/.hyprlock_sc_XXXXXX";
 
-    if (fcntl(FD, F_SETFD, flags | FD_CLOEXEC) == -1) {
-        close(FD);
-        Debug::log(CRIT, "createPoolFile: fcntl < 0");
-        return -1;
+        FD = mkostemp(name.data(), O_CLOEXEC);
+        if (FD < 0) {
+            Debug::log(CRIT, "createPoolFile: fd < 0");
+            return -1;
+        }
+
+        unlink(name.c_str());
     }
 
     if (ftruncate(FD, size) < 0) {
@@ -137,9 +135,26 @@ int createPoolFile(size_t size, std::string& name) {
         return -1;
     }
 
+    // fails harmlessly for the temp file fallback
+    fcntl(FD, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL);
+
     return FD;
 }
 
+std::string getCacheDir() {
+    const auto XDGCACHEHOME = getenv("XDG_CACHE_HOME");
+    if (XDGCACHEHOME && XDGCACHEHOME[0] != '\0')
+        return std::string(XDGCACHEHOME) + "/hyprlock";
+
+    const auto HOME = getenv("HOME");
+    if (!HOME) {
+        Debug::log(ERR, "Neither XDG_CACHE_HOME nor HOME are set!");
+        return "";
+    }
+
+    return std::string(HOME) + "/.cache/hyprlock";
+}
+
 std::string spawnSync(const std::string& cmd) {
     CProcess proc("/bin/sh", {"-c", cmd});
     if (!proc.runSync()) {
@@ -6,6 +6,7 @@
 
 std::string absolutePath(const std::string&, const std::string&);
 int64_t     configStringToInt(const std::string& VALUE);
-int         createPoolFile(size_t size, std::string& name);
+int         createPoolFile(size_t size);
+std::string getCacheDir();
 std::string spawnSync(const std::string& cmd);
 void        spawnAsync(const std::string& cmd);
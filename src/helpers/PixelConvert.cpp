@@ -0,0 +1,193 @@
+#include "PixelConvert.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXELCONVERT_X86
+#endif
+
+// a band has to be worth the thread
+constexpr uint32_t MINROWSPERBAND = 64;
+
+// 10 bit to 8 bit with rounding, (v * 255 + 511) / 1023 without the division. Exact for every 10 bit value.
+static inline uint32_t to8bit(uint32_t v) {
+    return ((v * 255 + 511) * 1025) >> 20;
+}
+
+static void swapRBScalar(uint8_t* data, size_t pixels) {
+    for (size_t i = 0; i < pixels; ++i) {
+        uint32_t px;
+        std::memcpy(&px, data + i * 4, 4);
+        px = (px & 0xFF00FF00) | ((px >> 16) & 0xFF) | ((px & 0xFF) << 16);
+        std::memcpy(data + i * 4, &px, 4);
+    }
+}
+
+static void convert2101010Scalar(uint8_t* data, size_t pixels, bool swapRB) {
+    for (size_t i = 0; i < pixels; ++i) {
+        uint32_t px;
+        std::memcpy(&px, data + i * 4, 4);
+
+        const uint32_t C0 = to8bit(px & 0x3FF);
+        const uint32_t C1 = to8bit((px >> 10) & 0x3FF);
+        const uint32_t C2 = to8bit((px >> 20) & 0x3FF);
+        const uint32_t A  = (px >> 30) * 85;
+
+        px = ((swapRB ? C2 : C0) << 0) | (C1 << 8) | ((swapRB ? C0 : C2) << 16) | (A << 24);
+        std::memcpy(data + i * 4, &px, 4);
+    }
+}
+
+static void expand24Scalar(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    for (size_t i = 0; i < pixels; ++i) {
+        dst[i * 4 + 0] = src[i * 3 + 0];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = 0xFF;
+    }
+}
+
+#ifdef PIXELCONVERT_X86
+__attribute__((target("avx2"))) static void swapRBAVX2(uint8_t* data, size_t pixels) {
+    const __m256i MASK = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t        i    = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        const auto PX = _mm256_loadu_si256((const __m256i*)(data + i * 4));
+        _mm256_storeu_si256((__m256i*)(data + i * 4), _mm256_shuffle_epi8(PX, MASK));
+    }
+
+    swapRBScalar(data + i * 4, pixels - i);
+}
+
+__attribute__((target("ssse3"))) static void swapRBSSSE3(uint8_t* data, size_t pixels) {
+    const __m128i MASK = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t        i    = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        const auto PX = _mm_loadu_si128((const __m128i*)(data + i * 4));
+        _mm_storeu_si128((__m128i*)(data + i * 4), _mm_shuffle_epi8(PX, MASK));
+    }
+
+    swapRBScalar(data + i * 4, pixels - i);
+}
+
+__attribute__((target("avx2"))) static inline __m256i to8bitAVX2(__m256i v) {
+    const auto X = _mm256_add_epi32(_mm256_mullo_epi32(v, _mm256_set1_epi32(255)), _mm256_set1_epi32(511));
+    return _mm256_srli_epi32(_mm256_mullo_epi32(X, _mm256_set1_epi32(1025)), 20);
+}
+
+__attribute__((target("avx2"))) static void convert2101010AVX2(uint8_t* data, size_t pixels, bool swapRB) {
+    const auto TENBITS = _mm256_set1_epi32(0x3FF);
+
+    size_t     i       = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        const auto PX = _mm256_loadu_si256((const __m256i*)(data + i * 4));
+
+        const auto C0 = to8bitAVX2(_mm256_and_si256(PX, TENBITS));
+        const auto C1 = to8bitAVX2(_mm256_and_si256(_mm256_srli_epi32(PX, 10), TENBITS));
+        const auto C2 = to8bitAVX2(_mm256_and_si256(_mm256_srli_epi32(PX, 20), TENBITS));
+        const auto A  = _mm256_mullo_epi32(_mm256_srli_epi32(PX, 30), _mm256_set1_epi32(85));
+
+        const auto LOW  = swapRB ? C2 : C0;
+        const auto HIGH = swapRB ? C0 : C2;
+        const auto OUT  = _mm256_or_si256(_mm256_or_si256(LOW, _mm256_slli_epi32(C1, 8)), _mm256_or_si256(_mm256_slli_epi32(HIGH, 16), _mm256_slli_epi32(A, 24)));
+        _mm256_storeu_si256((__m256i*)(data + i * 4), OUT);
+    }
+
+    convert2101010Scalar(data + i * 4, pixels - i, swapRB);
+}
+
+__attribute__((target("sse4.1"))) static inline __m128i to8bitSSE41(__m128i v) {
+    const auto X = _mm_add_epi32(_mm_mullo_epi32(v, _mm_set1_epi32(255)), _mm_set1_epi32(511));
+    return _mm_srli_epi32(_mm_mullo_epi32(X, _mm_set1_epi32(1025)), 20);
+}
+
+__attribute__((target("sse4.1"))) static void convert2101010SSE41(uint8_t* data, size_t pixels, bool swapRB) {
+    const auto TENBITS = _mm_set1_epi32(0x3FF);
+
+    size_t     i       = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        const auto PX = _mm_loadu_si128((const __m128i*)(data + i * 4));
+
+        const auto C0 = to8bitSSE41(_mm_and_si128(PX, TENBITS));
+        const auto C1 = to8bitSSE41(_mm_and_si128(_mm_srli_epi32(PX, 10), TENBITS));
+        const auto C2 = to8bitSSE41(_mm_and_si128(_mm_srli_epi32(PX, 20), TENBITS));
+        const auto A  = _mm_mullo_epi32(_mm_srli_epi32(PX, 30), _mm_set1_epi32(85));
+
+        const auto LOW  = swapRB ? C2 : C0;
+        const auto HIGH = swapRB ? C0 : C2;
+        const auto OUT  = _mm_or_si128(_mm_or_si128(LOW, _mm_slli_epi32(C1, 8)), _mm_or_si128(_mm_slli_epi32(HIGH, 16), _mm_slli_epi32(A, 24)));
+        _mm_storeu_si128((__m128i*)(data + i * 4), OUT);
+    }
+
+    convert2101010Scalar(data + i * 4, pixels - i, swapRB);
+}
+
+__attribute__((target("ssse3"))) static void expand24SSSE3(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    // 4 pixels out of the first 12 bytes, -1 zeroes the alpha byte which is then or'd in
+    const __m128i MASK  = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i ALPHA = _mm_set1_epi32(0xFF000000);
+
+    size_t        i     = 0;
+    // the load reads 16 bytes for 12, stay away from the end of the source
+    for (; i + 6 <= pixels; i += 4) {
+        const auto PX = _mm_loadu_si128((const __m128i*)(src + i * 3));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(PX, MASK), ALPHA));
+    }
+
+    expand24Scalar(src + i * 3, dst + i * 4, pixels - i);
+}
+#endif
+
+void PixelConvert::swapRB(uint8_t* data, size_t pixels) {
+#ifdef PIXELCONVERT_X86
+    if (__builtin_cpu_supports("avx2"))
+        return swapRBAVX2(data, pixels);
+    if (__builtin_cpu_supports("ssse3"))
+        return swapRBSSSE3(data, pixels);
+#endif
+    swapRBScalar(data, pixels);
+}
+
+void PixelConvert::convert2101010(uint8_t* data, size_t pixels, bool swapRB) {
+#ifdef PIXELCONVERT_X86
+    if (__builtin_cpu_supports("avx2"))
+        return convert2101010AVX2(data, pixels, swapRB);
+    if (__builtin_cpu_supports("sse4.1"))
+        return convert2101010SSE41(data, pixels, swapRB);
+#endif
+    convert2101010Scalar(data, pixels, swapRB);
+}
+
+void PixelConvert::expand24(const uint8_t* src, uint8_t* dst, size_t pixels) {
+#ifdef PIXELCONVERT_X86
+    if (__builtin_cpu_supports("ssse3"))
+        return expand24SSSE3(src, dst, pixels);
+#endif
+    expand24Scalar(src, dst, pixels);
+}
+
+void PixelConvert::forRowBands(uint32_t rows, const std::function<void(uint32_t, uint32_t)>& fn) {
+    const uint32_t BANDS = std::clamp<uint32_t>(rows / MINROWSPERBAND, 1, std::max(1U, std::thread::hardware_concurrency()));
+    const uint32_t ROWS  = (rows + BANDS - 1) / BANDS;
+
+    // the calling thread takes the first band
+    std::vector<std::thread> threads;
+    for (uint32_t band = 1; band < BANDS; ++band) {
+        const uint32_t FIRST = band * ROWS;
+        if (FIRST >= rows)
+            break;
+
+        threads.emplace_back([&fn, FIRST, END = std::min(rows, FIRST + ROWS)]() { fn(FIRST, END); });
+    }
+
+    fn(0, std::min(rows, ROWS));
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Pixel format conversions for SHM screencopy buffers.
+// Every function picks the widest SIMD variant the cpu supports at runtime.
+namespace PixelConvert {
+    // bytes 0 and 2 of every 32 bit pixel, in place
+    void swapRB(uint8_t* data, size_t pixels);
+
+    // 2:10:10:10 to 8:8:8:8, in place. swapRB swaps the 10 bit channels 0 and 2 while at it.
+    void convert2101010(uint8_t* data, size_t pixels, bool swapRB);
+
+    // 3 byte pixels to 4 byte ones with an opaque alpha byte appended
+    void expand24(const uint8_t* src, uint8_t* dst, size_t pixels);
+
+    // runs fn(firstRow, endRow) for bands of rows, spread over the available cores
+    void forRowBands(uint32_t rows, const std::function<void(uint32_t, uint32_t)>& fn);
+}
@@ -16,6 +16,8 @@ void help() {
                  "  --grace SECONDS          - Set grace period in seconds before requiring authentication\n"
                  "  --immediate-render       - Do not wait for resources before drawing the background\n"
                  "  --no-fade-in             - Disable the fade-in animation when the lock screen appears\n"
+                 "  --daemon                 - Stay resident and lock on \"lock\" sent to $XDG_RUNTIME_DIR/hyprlock.sock or SIGRTMIN+1\n"
+                 "  --benchmark-blur         - Time both blur engines on a 4K target and exit without locking\n"
                  "  -V, --version            - Show version information\n"
                  "  -h, --help               - Show this help message");
 }
@@ -42,6 +44,8 @@ int main(int argc, char** argv, char** envp) {
     std::string              wlDisplay;
     bool                     immediateRender = false;
     bool                     noFadeIn        = false;
+    bool                     daemon          = false;
+    bool                     benchmarkBlur   = false;
     int                      graceSeconds    = 0;
 
     std::vector<std::string> args(argv, argv + argc);
@@ -103,6 +107,12 @@ int main(int argc, char** argv, char** envp) {
         else if (arg == "--no-fade-in")
             noFadeIn = true;
 
+        else if (arg == "--daemon")
+            daemon = true;
+
+        else if (arg == "--benchmark-blur")
+            benchmarkBlur = true;
+
         else {
             std::println(stderr, "Unknown option: {}", arg);
             help();
@@ -128,7 +138,8 @@ int main(int argc, char** argv, char** envp) {
         g_pConfigManager->m_AnimationTree.setConfigForNode("fadeIn", false, 0.f, "default");
 
     try {
-        g_pHyprlock = makeUnique<CHyprlock>(wlDisplay, immediateRender, graceSeconds);
+        g_pHyprlock                   = makeUnique<CHyprlock>(wlDisplay, immediateRender, graceSeconds, daemon);
+        g_pHyprlock->m_bBenchmarkBlur = benchmarkBlur;
         g_pHyprlock->run();
     } catch (const std::exception& ex) {
         Debug::log(CRIT, "Hyprlock threw: {}", ex.what());
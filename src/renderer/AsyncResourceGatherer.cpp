@@ -1,12 +1,15 @@
 #include "AsyncResourceGatherer.hpp"
 #include "../config/ConfigManager.hpp"
-#include "../core/Egl.hpp"
 #include "../core/hyprlock.hpp"
 #include "../helpers/Color.hpp"
+#include "../helpers/CommandExecutor.hpp"
 #include "../helpers/Log.hpp"
 #include "../helpers/MiscFunctions.hpp"
+#include "GlyphAtlas.hpp"
+#include "widgets/Background.hpp"
 #include <algorithm>
 #include <cairo/cairo.h>
+#include <cstring>
 #include <filesystem>
 #include <pango/pangocairo.h>
 #include <sys/eventfd.h>
@@ -15,12 +18,87 @@
 using namespace Hyprgraphics;
 using namespace Hyprutils::OS;
 
+static bool widgetOnOutput(const CConfigManager::SWidgetConfig& c, const SP<COutput>& output) {
+    return c.monitor.empty() || c.monitor == output->stringPort || output->stringDesc.starts_with(c.monitor) || ("desc:" + output->stringDesc).starts_with(c.monitor);
+}
+
+// no lock surface yet, assume it will cover the whole output
+static Vector2D predictedViewport(const SP<COutput>& output) {
+    return output->transform % 2 == 1 ? Vector2D{output->size.y, output->size.x} : output->size;
+}
+
+// With a warm cache, CBackground never needs the decoded image
+static bool isBackgroundCached(const CConfigManager::SWidgetConfig& c, const SP<COutput>& output) {
+    static const auto BACKGROUNDCACHE = g_pConfigManager->getValue<Hyprlang::INT>("general:background_cache");
+
+    if (!*BACKGROUNDCACHE || std::any_cast<Hyprlang::INT>(c.values.at("blur_passes")) <= 0)
+        return false;
+
+    const auto CACHEFILE = CBackground::getCacheFile(c.values, predictedViewport(output), wlTransformToHyprutils(invertTransform(output->transform)));
+    return !CACHEFILE.empty() && std::filesystem::exists(CACHEFILE);
+}
+
 CAsyncResourceGatherer::CAsyncResourceGatherer() {
-    if (g_pHyprlock->getScreencopy())
+    // the daemon captures the screen when asked to lock
+    if (g_pHyprlock->getScreencopy() && !g_pHyprlock->m_bDaemon)
         enqueueScreencopyFrames();
 
-    initialGatherThread = std::thread([this]() { this->gather(); });
-    asyncLoopThread     = std::thread([this]() { this->asyncAssetSpinLock(); });
+    // gather resources to preload, one request per unique resource
+    std::vector<SPreloadRequest> requests;
+    for (auto& c : g_pConfigManager->getWidgetConfigs()) {
+        if (c.type != "background" && c.type != "image")
+            continue;
+
+        std::string path = std::any_cast<Hyprlang::STRING>(c.values.at("path"));
+
+        if (path.empty() || path == "screenshot")
+            continue;
+
+        // decoded at the size the widgets are going to show them at
+        std::vector<Vector2D> coverSizes;
+        if (c.type == "image") {
+            const auto SIZE = std::any_cast<Hyprlang::INT>(c.values.at("size"));
+            coverSizes.emplace_back((double)SIZE, (double)SIZE);
+        } else {
+            for (const auto& MON : g_pHyprlock->m_vOutputs) {
+                if (!widgetOnOutput(c, MON))
+                    continue;
+
+                if (isBackgroundCached(c, MON)) {
+                    Debug::log(LOG, "Skipping decode of cached background {} for output {}", path, MON->stringPort);
+                    continue;
+                }
+
+                coverSizes.emplace_back(predictedViewport(MON));
+            }
+        }
+
+        for (const auto& COVERSIZE : coverSizes) {
+            SPreloadRequest rq;
+            rq.type                = TARGET_IMAGE;
+            rq.asset               = path;
+            rq.props["cover_size"] = COVERSIZE;
+
+            // the gatherer keeps a reference to the initial assets, so they survive widget reloads
+            auto& entry = findOrAddAsset(rq);
+            if (entry.pending)
+                continue;
+
+            entry.refs++;
+            entry.pending = true;
+            requests.emplace_back(rq);
+        }
+    }
+
+    const size_t WORKERS = std::clamp(std::thread::hardware_concurrency(), 2U, 4U);
+    for (size_t i = 0; i < WORKERS; ++i) {
+        workers.emplace_back(makeUnique<SWorker>());
+        workers.back()->thread = std::thread([this, i]() { this->asyncAssetSpinLock(i); });
+    }
+
+    Debug::log(LOG, "Started {} asset workers", WORKERS);
+
+    initialGatherThread = std::thread([this, requests = std::move(requests)]() { this->gather(requests); });
 
     gatheredEventfd = CFileDescriptor{eventfd(0, EFD_CLOEXEC)};
     if (!gatheredEventfd.isValid())
@@ -46,36 +124,141 @@ void CAsyncResourceGatherer::enqueueScreencopyFrames() {
         return;
     }
 
+    {
+        std::lock_guard lg(scLatch.mutex);
+        scLatch.remaining = g_pHyprlock->m_vOutputs.size();
+    }
+
     for (const auto& MON : g_pHyprlock->m_vOutputs) {
-        scframes.emplace_back(makeUnique<CScreencopyFrame>(MON));
+        scframes.emplace_back(makeUnique<CScreencopyFrame>(MON, [this]() {
+            std::lock_guard lg(scLatch.mutex);
+            if (scLatch.remaining > 0)
+                scLatch.remaining--;
+
+            scLatch.cv.notify_all();
+        }));
     }
 }
 
-SPreloadedAsset* CAsyncResourceGatherer::getAssetByID(const std::string& id) {
-    if (id.contains(CScreencopyFrame::RESOURCEIDPREFIX)) {
-        for (auto& frame : scframes) {
-            if (id == frame->m_resourceID)
-                return frame->m_asset.ready ? &frame->m_asset : nullptr;
-        }
+void CAsyncResourceGatherer::recaptureScreencopy() {
+    if (initialGatherThread.joinable())
+        initialGatherThread.join();
 
-        return nullptr;
+    gathered = false;
+    scframes.clear();
+
+    if (g_pHyprlock->getScreencopy())
+        enqueueScreencopyFrames();
+
+    // decoded images are kept, so this only waits for the new frames
+    initialGatherThread = std::thread([this]() { this->gather({}); });
+}
+
+int64_t CAsyncResourceGatherer::expireScreencopyFrames() {
+    const auto NOW    = std::chrono::steady_clock::now();
+    int64_t    nextMs = -1;
+
+    for (auto& frame : scframes) {
+        if (frame->expire(NOW))
+            continue;
+
+        const auto LEFTMS = std::chrono::duration_cast<std::chrono::milliseconds>(frame->m_deadline - NOW).count() + 1;
+        nextMs            = nextMs < 0 ? LEFTMS : std::min(nextMs, LEFTMS);
     }
 
-    for (auto& a : assets) {
-        if (a.first == id)
-            return &a.second;
+    return nextMs;
+}
+
+SPreloadedAsset* CAsyncResourceGatherer::getAssetByID(ResourceID id) {
+    if (id == 0)
+        return nullptr;
+
+    if (const auto IT = assets.find(id); IT != assets.end() && IT->second.asset.ready)
+        return &IT->second.asset;
+
+    for (auto& frame : scframes) {
+        if (id == frame->m_resourceID)
+            return frame->m_asset.ready ? &frame->m_asset : nullptr;
     }
 
     if (apply()) {
-        for (auto& a : assets) {
-            if (a.first == id)
-                return &a.second;
-        }
-    };
+        if (const auto IT = assets.find(id); IT != assets.end() && IT->second.asset.ready)
+            return &IT->second.asset;
+    }
 
     return nullptr;
 }
 
+// length prefixed, so different fields never add up to the same key
+static void appendKeyField(std::string& key, const std::string& field) {
+    key += std::format("{}:{};", field.size(), field);
+}
+
+std::string CAsyncResourceGatherer::assetKeyForRequest(const SPreloadRequest& rq) {
+    std::string key;
+
+    if (rq.type == TARGET_IMAGE) {
+        const auto      ABSOLUTEPATH = absolutePath(rq.asset, "");
+        std::error_code ec;
+        const auto      MTIME = std::filesystem::last_write_time(ABSOLUTEPATH, ec);
+
+        appendKeyField(key, "image");
+        appendKeyField(key, ABSOLUTEPATH);
+        appendKeyField(key, std::to_string(ec ? 0 : MTIME.time_since_epoch().count()));
+
+        if (rq.props.contains("cover_size")) {
+            const auto COVERSIZE = std::any_cast<Vector2D>(rq.props.at("cover_size")).round();
+            appendKeyField(key, std::format("{}x{}", COVERSIZE.x, COVERSIZE.y));
+        }
+    } else {
+        // the output of a command is not known up front, those never get shared
+        if (rq.props.contains("cmd") && std::any_cast<bool>(rq.props.at("cmd")))
+            return "";
+
+        // has to cover every prop that renderText looks at
+        const auto FONTSIZE   = rq.props.contains("font_size") ? std::any_cast<int>(rq.props.at("font_size")) : 16;
+        const auto FONTCOLOR  = rq.props.contains("color") ? std::any_cast<CHyprColor>(rq.props.at("color")) : CHyprColor(1.0, 1.0, 1.0, 1.0);
+        const auto FONTFAMILY = rq.props.contains("font_family") ? std::any_cast<std::string>(rq.props.at("font_family")) : "Sans";
+        const auto TEXTALIGN  = rq.props.contains("text_align") ? std::any_cast<std::string>(rq.props.at("text_align")) : "";
+
+        appendKeyField(key, "text");
+        appendKeyField(key, rq.asset);
+        appendKeyField(key, FONTFAMILY);
+        appendKeyField(key, std::to_string(FONTSIZE));
+        appendKeyField(key, std::format("{} {} {} {}", FONTCOLOR.r, FONTCOLOR.g, FONTCOLOR.b, FONTCOLOR.a));
+        appendKeyField(key, TEXTALIGN);
+    }
+
+    return key;
+}
+
+CAsyncResourceGatherer::SAssetEntry& CAsyncResourceGatherer::findOrAddAsset(SPreloadRequest& rq) {
+    const auto KEY = assetKeyForRequest(rq);
+    if (!KEY.empty()) {
+        if (const auto IT = assetIDs.find(KEY); IT != assetIDs.end()) {
+            rq.id = IT->second;
+            return assets.at(rq.id);
+        }
+    }
+
+    rq.id = nextAssetID++;
+    if (!KEY.empty())
+        assetIDs.emplace(KEY, rq.id);
+
+    auto& entry = assets[rq.id];
+    entry.key   = KEY;
+    return entry;
+}
+
+ResourceID CAsyncResourceGatherer::findAsset(const SPreloadRequest& rq) const {
+    const auto KEY = assetKeyForRequest(rq);
+    if (KEY.empty())
+        return 0;
+
+    const auto IT = assetIDs.find(KEY);
+    return IT == assetIDs.end() ? 0 : IT->second;
+}
+
 static SP<CCairoSurface> getCairoSurfaceFromImageFile(const std::filesystem::path& path) {
     auto image = CImage(path);
     if (!image.success()) {
@@ -86,51 +269,103 @@ static SP<CCairoSurface> getCairoSurfaceFromImageFile(const std::filesystem::pat
     return image.cairoSurface();
 }
 
-void CAsyncResourceGatherer::gather() {
-    const auto CWIDGETS = g_pConfigManager->getWidgetConfigs();
+// Scales the image down so it still covers coverSize. Never scales up.
+static SP<CCairoSurface> scaleToCover(const SP<CCairoSurface>& source, const Vector2D& coverSize) {
+    const auto  SOURCESIZE = source->size();
+    const float SCALE      = std::max(coverSize.x / SOURCESIZE.x, coverSize.y / SOURCESIZE.y);
+
+    if (SCALE >= 1.F || coverSize.x < 1 || coverSize.y < 1)
+        return source;
+
+    const auto SCALEDSIZE = (SOURCESIZE * SCALE).round();
+    auto       scaled     = makeShared<CCairoSurface>(cairo_image_surface_create(cairo_image_surface_get_format(source->cairo()), SCALEDSIZE.x, SCALEDSIZE.y));
+    if (scaled->status() != CAIRO_STATUS_SUCCESS)
+        return source;
+
+    const auto CAIRO = cairo_create(scaled->cairo());
+    cairo_scale(CAIRO, SCALEDSIZE.x / SOURCESIZE.x, SCALEDSIZE.y / SOURCESIZE.y);
+    cairo_set_source_surface(CAIRO, source->cairo(), 0, 0);
+    // GOOD box filters when downscaling, so small targets do not alias
+    cairo_pattern_set_filter(cairo_get_source(CAIRO), CAIRO_FILTER_GOOD);
+    cairo_set_operator(CAIRO, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(CAIRO);
+    cairo_destroy(CAIRO);
+
+    cairo_surface_flush(scaled->cairo());
+    return scaled;
+}
+
+static void addProgress(std::atomic<float>& progress, float amount) {
+    float current = progress.load();
+    while (!progress.compare_exchange_weak(current, current + amount)) {
+        ;
+    }
+}
 
-    g_pEGL->makeCurrent(nullptr);
+static int64_t msSince(const std::chrono::system_clock::time_point& tp) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - tp).count();
+}
 
-    // gather resources to preload
-    // clang-format off
-    int preloads = std::count_if(CWIDGETS.begin(), CWIDGETS.end(), [](const auto& w) {
-        return w.type == "background" || w.type == "image";
-    });
-    // clang-format on
+void CAsyncResourceGatherer::gather(const std::vector<SPreloadRequest>& requests) {
+    const auto STARTGATHERTP = std::chrono::system_clock::now();
 
     progress = 0;
-    for (auto& c : CWIDGETS) {
-        if (c.type == "background" || c.type == "image") {
-#if defined(_LIBCPP_VERSION) && _LIBCPP_VERSION < 180100
-            progress = progress + 1.0 / (preloads + 1.0);
-#else
-            progress += 1.0 / (preloads + 1.0);
-#endif
 
-            std::string path = std::any_cast<Hyprlang::STRING>(c.values.at("path"));
+    // the workers decode the images in parallel, ahead of anything else.
+    // time to lock should scale with the largest image, not the sum of all of them.
+    const float PROGRESSPERJOB = 1.0 / (requests.size() + 1.0);
+    {
+        std::lock_guard lg(initialLatch.mutex);
+        initialLatch.remaining      = requests.size();
+        initialLatch.progressPerJob = PROGRESSPERJOB;
+    }
+
+    for (auto rq : requests) {
+        rq.priority = PRIORITY_HIGH;
+        rq.initial  = true;
+        enqueueRequest(std::move(rq));
+    }
 
-            if (path.empty() || path == "screenshot")
-                continue;
+    {
+        std::unique_lock lk(initialLatch.mutex);
+        initialLatch.cv.wait(lk, [this] { return initialLatch.remaining == 0 || g_pHyprlock->m_bTerminate; });
+    }
 
-            std::string id = (c.type == "background" ? std::string{"background:"} : std::string{"image:"}) + path;
+    Debug::log(LOG, "[gather] decoded {} image(s) on {} worker(s) in {}ms", requests.size(), workers.size(), msSince(STARTGATHERTP));
 
-            // render the image directly, since we are in a seperate thread
-            CAsyncResourceGatherer::SPreloadRequest rq;
-            rq.type  = CAsyncResourceGatherer::TARGET_IMAGE;
-            rq.asset = path;
-            rq.id    = id;
+    const auto STARTSCWAITTP = std::chrono::system_clock::now();
 
-            renderImage(rq);
-        }
+    {
+        std::unique_lock lk(scLatch.mutex);
+        scLatch.cv.wait(lk, [this] { return scLatch.remaining == 0 || g_pHyprlock->m_bTerminate; });
+    }
+
+    // We are done with screencopy. Failed frames count as done, widgets fall back to their colors.
+    Debug::log(LOG, "[gather] waited {}ms for {} screencopy frame(s)", msSince(STARTSCWAITTP), scframes.size());
+    if (!scframes.empty())
+        CScreencopyFrame::saveTimings();
+
+    if (!g_pHyprlock->m_bDaemon) {
+        Debug::log(TRACE, "Gathered all screencopy frames - removing dmabuf listeners");
+        g_pHyprlock->addTimer(std::chrono::milliseconds(0), [](auto, auto) { g_pHyprlock->removeDmabufListener(); }, nullptr);
     }
 
-// TODO: wake this thread when all scframes are done instead of busy waiting.
-    while (!g_pHyprlock->m_bTerminate && std::ranges::any_of(scframes, [](const auto& d) { return !d->m_asset.ready; })) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::vector<ResourceID> ids;
+    for (const auto& rq : requests) {
+        ids.push_back(rq.id);
     }
-    // We are done with screencopy.
-    Debug::log(TRACE, "Gathered all screencopy frames - removing dmabuf listeners");
-    g_pHyprlock->addTimer(std::chrono::milliseconds(0), [](auto, auto) { g_pHyprlock->removeDmabufListener(); }, nullptr);
+
+    g_pHyprlock->addTimer(
+        std::chrono::milliseconds(0),
+        [this, ids](auto, auto) {
+            for (const auto& id : ids) {
+                dispatchCallbacks(id);
+            }
+        },
+        nullptr);
+
+    addProgress(progress, PROGRESSPERJOB);
+    Debug::log(LOG, "[gather] done after {}ms", msSince(STARTGATHERTP));
 
     gathered = true;
     // wake hyprlock from poll
@@ -139,66 +374,186 @@ void CAsyncResourceGatherer::gather() {
 }
 
 bool CAsyncResourceGatherer::apply() {
-    preloadTargetsMutex.lock();
+    const auto applyTarget = [this](SPreloadTarget&& t) {
+        const auto ENTRY = assets.find(t.id);
+        if (ENTRY == assets.end()) {
+            // unloaded before the upload happened
+            Debug::log(TRACE, "Dropping unused resource {}", t.id);
+            cairo_destroy((cairo_t*)t.cairo);
+            return;
+        }
 
-    if (preloadTargets.empty()) {
-        preloadTargetsMutex.unlock();
-        return false;
-    }
+        if (t.type != TARGET_IMAGE) {
+            Debug::log(ERR, "Unsupported type in ::apply(): {}", (int)t.type);
+            return;
+        }
 
-    auto currentPreloadTargets = preloadTargets;
-    preloadTargets.clear();
-    preloadTargetsMutex.unlock();
+        const auto           ASSET = &ENTRY->second.asset;
 
-    for (auto& t : currentPreloadTargets) {
-        if (t.type == TARGET_IMAGE) {
-            const auto           ASSET = &assets[t.id];
+        const cairo_status_t SURFACESTATUS = (cairo_status_t)t.cairosurface->status();
+        const auto           CAIROFORMAT   = cairo_image_surface_get_format(t.cairosurface->cairo());
+        const GLint          glIFormat     = CAIROFORMAT == CAIRO_FORMAT_RGB96F ? GL_RGB32F : GL_RGBA;
+        const GLint          glFormat      = CAIROFORMAT == CAIRO_FORMAT_RGB96F ? GL_RGB : GL_RGBA;
+        const GLint          glType        = CAIROFORMAT == CAIRO_FORMAT_RGB96F ? GL_FLOAT : GL_UNSIGNED_BYTE;
+        const size_t         BYTES         = (size_t)cairo_image_surface_get_stride(t.cairosurface->cairo()) * t.size.y;
 
-            const cairo_status_t SURFACESTATUS = (cairo_status_t)t.cairosurface->status();
-            const auto           CAIROFORMAT   = cairo_image_surface_get_format(t.cairosurface->cairo());
-            const GLint          glIFormat     = CAIROFORMAT == CAIRO_FORMAT_RGB96F ? GL_RGB32F : GL_RGBA;
-            const GLint          glFormat      = CAIROFORMAT == CAIRO_FORMAT_RGB96F ? GL_RGB : GL_RGBA;
-            const GLint          glType        = CAIROFORMAT == CAIRO_FORMAT_RGB96F ? GL_FLOAT : GL_UNSIGNED_BYTE;
+        if (SURFACESTATUS != CAIRO_STATUS_SUCCESS) {
+            Debug::log(ERR, "Resource {} invalid ({})", t.id, cairo_status_to_string(SURFACESTATUS));
+            ASSET->texture.m_iType = TEXTURE_INVALID;
+        }
 
-            if (SURFACESTATUS != CAIRO_STATUS_SUCCESS) {
-                Debug::log(ERR, "Resource {} invalid ({})", t.id, cairo_status_to_string(SURFACESTATUS));
-                ASSET->texture.m_iType = TEXTURE_INVALID;
-            }
+        ASSET->texture.m_vSize = t.size;
+        ASSET->texture.allocate();
 
-            ASSET->texture.m_vSize = t.size;
-            ASSET->texture.allocate();
+        glBindTexture(GL_TEXTURE_2D, ASSET->texture.m_iTexID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        if (CAIROFORMAT != CAIRO_FORMAT_RGB96F) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        }
 
-            glBindTexture(GL_TEXTURE_2D, ASSET->texture.m_iTexID);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            if (CAIROFORMAT != CAIRO_FORMAT_RGB96F) {
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
-            }
+        if (SURFACESTATUS != CAIRO_STATUS_SUCCESS || !t.stream || BYTES <= STREAMINGTHRESHOLD) {
             glTexImage2D(GL_TEXTURE_2D, 0, glIFormat, ASSET->texture.m_vSize.x, ASSET->texture.m_vSize.y, 0, glFormat, glType, t.data);
+            ASSET->ready = true;
 
             cairo_destroy((cairo_t*)t.cairo);
             t.cairosurface.reset();
-        } else
-            Debug::log(ERR, "Unsupported type in ::apply(): {}", (int)t.type);
+            return;
+        }
+
+        // too big for a single frame, allocate the storage now and let streamUploads() fill it in
+        glTexImage2D(GL_TEXTURE_2D, 0, glIFormat, ASSET->texture.m_vSize.x, ASSET->texture.m_vSize.y, 0, glFormat, glType, nullptr);
+
+        SUpload upload{.target = std::move(t), .format = (GLenum)glFormat, .type = (GLenum)glType};
+        glGenBuffers(1, &upload.pbo);
+
+        Debug::log(LOG, "Streaming resource {} ({} bytes)", upload.target.id, BYTES);
+        uploads.emplace_back(std::move(upload));
+    };
+
+    // take everything the workers finished so far in one go
+    size_t                      applied = preloadTargets.drain(applyTarget);
+
+    std::vector<SPreloadTarget> spilled;
+    {
+        std::lock_guard lg(spilledTargetsMutex);
+        spilled.swap(spilledTargets);
+    }
+
+    for (auto& t : spilled) {
+        applyTarget(std::move(t));
     }
 
-    return true;
+    applied += spilled.size();
+    return applied > 0;
 }
 
-void CAsyncResourceGatherer::renderImage(const SPreloadRequest& rq) {
+bool CAsyncResourceGatherer::streamUploads() {
+    size_t budget = UPLOADBUDGET;
+
+    for (auto it = uploads.begin(); it != uploads.end();) {
+        auto&      upload = *it;
+        const auto ENTRY  = assets.find(upload.target.id);
+
+        const auto finish = [&]() {
+            if (upload.fence)
+                glDeleteSync(upload.fence);
+
+            glDeleteBuffers(1, &upload.pbo);
+            cairo_destroy((cairo_t*)upload.target.cairo);
+            it = uploads.erase(it);
+        };
+
+        if (ENTRY == assets.end()) {
+            // unloaded while streaming, the texture is gone with it
+            finish();
+            continue;
+        }
+
+        if (upload.fence) {
+            const auto STATUS = glClientWaitSync(upload.fence, 0, 0);
+            if (STATUS == GL_TIMEOUT_EXPIRED) {
+                ++it;
+                continue;
+            }
+
+            ENTRY->second.asset.ready = true;
+            g_pHyprlock->addTimer(std::chrono::milliseconds(0), [this, ID = upload.target.id](auto, auto) { dispatchCallbacks(ID); }, nullptr);
+            finish();
+            continue;
+        }
+
+        if (budget == 0) {
+            ++it;
+            continue;
+        }
+
+        const auto   CAIRO   = upload.target.cairosurface->cairo();
+        const size_t STRIDE  = cairo_image_surface_get_stride(CAIRO);
+        const size_t BPP     = upload.type == GL_FLOAT ? 12 : 4;
+        const size_t HEIGHT  = upload.target.size.y;
+        const size_t ROWS    = std::clamp<size_t>(budget / STRIDE, 1, HEIGHT - upload.rowsUploaded);
+        const size_t BYTES   = ROWS * STRIDE;
+        const auto   SRCDATA = (const uint8_t*)upload.target.data + upload.rowsUploaded * STRIDE;
+
+        // orphan the previous chunk instead of waiting for it
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, BYTES, nullptr, GL_STREAM_DRAW);
+        const auto DST = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, BYTES, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!DST) {
+            Debug::log(ERR, "Failed to map the upload buffer for resource {}", upload.target.id);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            ENTRY->second.asset.texture.m_iType = TEXTURE_INVALID;
+            upload.rowsUploaded                 = HEIGHT;
+            upload.fence                        = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            ++it;
+            continue;
+        }
+
+        std::memcpy(DST, SRCDATA, BYTES);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        glBindTexture(GL_TEXTURE_2D, ENTRY->second.asset.texture.m_iTexID);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, STRIDE / BPP);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, upload.rowsUploaded, upload.target.size.x, ROWS, upload.format, upload.type, nullptr);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        upload.rowsUploaded += ROWS;
+        budget -= std::min(budget, BYTES);
+
+        // the texture is only handed out once the gpu is done with it
+        if (upload.rowsUploaded >= HEIGHT)
+            upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        ++it;
+    }
+
+    return !uploads.empty();
+}
+
+void CAsyncResourceGatherer::renderImage(const SPreloadRequest& rq, bool stream) {
     SPreloadTarget target;
     target.type = TARGET_IMAGE;
     target.id   = rq.id;
 
     std::filesystem::path ABSOLUTEPATH(absolutePath(rq.asset, ""));
-    const auto            CAIROISURFACE = getCairoSurfaceFromImageFile(ABSOLUTEPATH);
+    auto                  CAIROISURFACE = getCairoSurfaceFromImageFile(ABSOLUTEPATH);
 
     if (!CAIROISURFACE) {
         Debug::log(ERR, "renderImage: No cairo surface!");
         return;
     }
 
+    // no point in keeping and uploading more pixels than will be shown
+    if (rq.props.contains("cover_size")) {
+        const auto FULLSIZE = CAIROISURFACE->size();
+        CAIROISURFACE       = scaleToCover(CAIROISURFACE, std::any_cast<Vector2D>(rq.props.at("cover_size")));
+        if (CAIROISURFACE->size() != FULLSIZE)
+            Debug::log(LOG, "renderImage: scaled {} from {} to {}", rq.asset, FULLSIZE, CAIROISURFACE->size());
+    }
+
     const auto CAIRO = cairo_create(CAIROISURFACE->cairo());
     cairo_scale(CAIRO, 1, 1);
 
@@ -206,46 +561,70 @@ void CAsyncResourceGatherer::renderImage(const SPreloadRequest& rq) {
     target.cairosurface = CAIROISURFACE;
     target.data         = CAIROISURFACE->data();
     target.size         = CAIROISURFACE->size();
+    target.stream       = stream;
 
-    std::lock_guard lg{preloadTargetsMutex};
-    preloadTargets.push_back(target);
+    pushTarget(std::move(target));
 }
 
-void CAsyncResourceGatherer::renderText(const SPreloadRequest& rq) {
-    SPreloadTarget target;
-    target.type = TARGET_IMAGE; /* text is just an image lol */
-    target.id   = rq.id;
+// Pango state of one worker thread. Font descriptions and laid out text are kept around,
+// so text that comes back (placeholders, fail messages) does not get laid out again.
+struct STextLayoutCache {
+    PangoContext*                                          context = nullptr;
+    std::unordered_map<std::string, PangoFontDescription*> fontDescs;
+    std::unordered_map<std::string, PangoLayout*>          layouts;
 
-    const int         FONTSIZE   = rq.props.contains("font_size") ? std::any_cast<int>(rq.props.at("font_size")) : 16;
-    const CHyprColor  FONTCOLOR  = rq.props.contains("color") ? std::any_cast<CHyprColor>(rq.props.at("color")) : CHyprColor(1.0, 1.0, 1.0, 1.0);
-    const std::string FONTFAMILY = rq.props.contains("font_family") ? std::any_cast<std::string>(rq.props.at("font_family")) : "Sans";
-    const bool        ISCMD      = rq.props.contains("cmd") ? std::any_cast<bool>(rq.props.at("cmd")) : false;
+    ~STextLayoutCache() {
+        clearLayouts();
 
-    static const auto TRIM = g_pConfigManager->getValue<Hyprlang::INT>("general:text_trim");
-    std::string       text = ISCMD ? spawnSync(rq.asset) : rq.asset;
+        for (const auto& [_, desc] : fontDescs) {
+            pango_font_description_free(desc);
+        }
 
-    if (*TRIM) {
-        text.erase(0, text.find_first_not_of(" \n\r\t"));
-        text.erase(text.find_last_not_of(" \n\r\t") + 1);
+        if (context)
+            g_object_unref(context);
     }
 
-    auto CAIROSURFACE = makeShared<CCairoSurface>(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1920, 1080 /* dummy value */));
-    auto CAIRO        = cairo_create(CAIROSURFACE->cairo());
+    void clearLayouts() {
+        for (const auto& [_, layout] : layouts) {
+            g_object_unref(layout);
+        }
 
-    // draw title using Pango
-    PangoLayout*          layout = pango_cairo_create_layout(CAIRO);
+        layouts.clear();
+    }
+};
+
+constexpr size_t                     MAXCACHEDLAYOUTS = 32;
+static thread_local STextLayoutCache textLayoutCache;
+
+static PangoFontDescription* getFontDescription(const std::string& fontFamily, int fontSize) {
+    const auto KEY  = std::format("{}:{}", fontFamily, fontSize);
+    auto&      desc = textLayoutCache.fontDescs[KEY];
+    if (!desc) {
+        desc = pango_font_description_from_string(fontFamily.c_str());
+        pango_font_description_set_size(desc, fontSize * PANGO_SCALE);
+    }
+
+    return desc;
+}
+
+// returns a laid out layout for the text, owned by the cache
+static PangoLayout* getTextLayout(const std::string& text, const std::string& fontFamily, int fontSize, const std::string& textAlign) {
+    const auto KEY = std::format("{}:{}:{}\n{}", fontFamily, fontSize, textAlign, text);
+    if (const auto IT = textLayoutCache.layouts.find(KEY); IT != textLayoutCache.layouts.end())
+        return IT->second;
 
-    PangoFontDescription* fontDesc = pango_font_description_from_string(FONTFAMILY.c_str());
-    pango_font_description_set_size(fontDesc, FONTSIZE * PANGO_SCALE);
-    pango_layout_set_font_description(layout, fontDesc);
-    pango_font_description_free(fontDesc);
+    // same font options as a layout made with pango_cairo_create_layout on the target surface
+    if (!textLayoutCache.context)
+        textLayoutCache.context = createImageTextContext();
 
-    if (rq.props.contains("text_align")) {
-        const std::string TEXTALIGN = std::any_cast<std::string>(rq.props.at("text_align"));
-        PangoAlignment    align     = PANGO_ALIGN_LEFT;
-        if (TEXTALIGN == "center")
+    PangoLayout* layout = pango_layout_new(textLayoutCache.context);
+    pango_layout_set_font_description(layout, getFontDescription(fontFamily, fontSize));
+
+    if (!textAlign.empty()) {
+        PangoAlignment align = PANGO_ALIGN_LEFT;
+        if (textAlign == "center")
             align = PANGO_ALIGN_CENTER;
-        else if (TEXTALIGN == "right")
+        else if (textAlign == "right")
             align = PANGO_ALIGN_RIGHT;
 
         pango_layout_set_alignment(layout, align);
@@ -272,13 +651,49 @@ void CAsyncResourceGatherer::renderText(const SPreloadRequest& rq) {
     pango_layout_set_attributes(layout, attrList);
     pango_attr_list_unref(attrList);
 
-    int layoutWidth, layoutHeight;
+    if (textLayoutCache.layouts.size() >= MAXCACHEDLAYOUTS)
+        textLayoutCache.clearLayouts();
+
+    textLayoutCache.layouts.emplace(KEY, layout);
+    return layout;
+}
+
+void CAsyncResourceGatherer::renderText(const SPreloadRequest& rq) {
+    SPreloadTarget target;
+    target.type = TARGET_IMAGE; /* text is just an image lol */
+    target.id   = rq.id;
+
+    const int         FONTSIZE   = rq.props.contains("font_size") ? std::any_cast<int>(rq.props.at("font_size")) : 16;
+    const CHyprColor  FONTCOLOR  = rq.props.contains("color") ? std::any_cast<CHyprColor>(rq.props.at("color")) : CHyprColor(1.0, 1.0, 1.0, 1.0);
+    const std::string FONTFAMILY = rq.props.contains("font_family") ? std::any_cast<std::string>(rq.props.at("font_family")) : "Sans";
+    const std::string TEXTALIGN  = rq.props.contains("text_align") ? std::any_cast<std::string>(rq.props.at("text_align")) : "";
+    const bool        ISCMD      = rq.props.contains("cmd") ? std::any_cast<bool>(rq.props.at("cmd")) : false;
+    const int         UPDATEMS   = rq.props.contains("update_ms") ? std::any_cast<int>(rq.props.at("update_ms")) : 0;
+
+    static const auto TRIM = g_pConfigManager->getValue<Hyprlang::INT>("general:text_trim");
+    std::string       text = rq.asset;
+
+    if (ISCMD) {
+        // labels on other monitors fire at about the same time, half an interval catches all of them.
+        // A slow command just updates late, only one that hangs for several intervals gets killed.
+        const auto TTL     = std::chrono::milliseconds(UPDATEMS / 2);
+        const auto TIMEOUT = std::chrono::milliseconds(std::max(UPDATEMS * 4, 10000));
+        text               = g_pCommandExecutor->run(rq.asset, TTL, TIMEOUT);
+    }
+
+    if (*TRIM) {
+        text.erase(0, text.find_first_not_of(" \n\r\t"));
+        text.erase(text.find_last_not_of(" \n\r\t") + 1);
+    }
+
+    // draw title using Pango
+    PangoLayout* layout = getTextLayout(text, FONTFAMILY, FONTSIZE, TEXTALIGN);
+
+    int          layoutWidth, layoutHeight;
     pango_layout_get_size(layout, &layoutWidth, &layoutHeight);
 
-    // TODO: avoid this?
-    cairo_destroy(CAIRO);
-    CAIROSURFACE = makeShared<CCairoSurface>(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, layoutWidth / PANGO_SCALE, layoutHeight / PANGO_SCALE));
-    CAIRO        = cairo_create(CAIROSURFACE->cairo());
+    const auto CAIROSURFACE = makeShared<CCairoSurface>(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, layoutWidth / PANGO_SCALE, layoutHeight / PANGO_SCALE));
+    const auto CAIRO        = cairo_create(CAIROSURFACE->cairo());
 
     // clear the pixmap
     cairo_save(CAIRO);
@@ -292,8 +707,6 @@ void CAsyncResourceGatherer::renderText(const SPreloadRequest& rq) {
     cairo_move_to(CAIRO, 0, 0);
     pango_cairo_show_layout(CAIRO, layout);
 
-    g_object_unref(layout);
-
     cairo_surface_flush(CAIROSURFACE->cairo());
 
     target.cairo        = CAIRO;
@@ -301,72 +714,225 @@ void CAsyncResourceGatherer::renderText(const SPreloadRequest& rq) {
     target.data         = CAIROSURFACE->data();
     target.size         = {layoutWidth / (double)PANGO_SCALE, layoutHeight / (double)PANGO_SCALE};
 
-    std::lock_guard lg{preloadTargetsMutex};
-    preloadTargets.push_back(target);
+    pushTarget(std::move(target));
 }
 
-void CAsyncResourceGatherer::asyncAssetSpinLock() {
-    while (!g_pHyprlock->m_bTerminate) {
+void CAsyncResourceGatherer::pushTarget(SPreloadTarget&& target) {
+    // only fills up if nothing gets rendered for a while. A failed push leaves the target untouched.
+    if (preloadTargets.push(std::move(target)))
+        return;
 
-        std::unique_lock lk(asyncLoopState.requestsMutex);
-        if (!asyncLoopState.pending) // avoid a lock if a thread managed to request something already since we .unlock()ed
-            asyncLoopState.requestsCV.wait_for(lk, std::chrono::seconds(5), [this] { return asyncLoopState.pending; }); // wait for events
+    std::lock_guard lg(spilledTargetsMutex);
+    spilledTargets.emplace_back(std::move(target));
+}
 
-        asyncLoopState.pending = false;
+std::optional<CAsyncResourceGatherer::SPreloadRequest> CAsyncResourceGatherer::popRequest(size_t workerIdx) {
+    // highest priority first. Own queue first, then try to steal from the others
+    for (int prio = PRIORITY_HIGH; prio >= PRIORITY_LOW; --prio) {
+        for (size_t i = 0; i < workers.size(); ++i) {
+            auto rq = workers[(workerIdx + i) % workers.size()]->queues[prio].pop();
+            if (!rq)
+                continue;
 
-        if (asyncLoopState.requests.empty()) {
-            lk.unlock();
-            continue;
+            if (i != 0)
+                Debug::log(TRACE, "Worker {} stole resourceID {}", workerIdx, rq->id);
+
+            asyncLoopState.pending--;
+            return rq;
         }
+    }
+
+    // overflow from enqueueRequest, the queues are empty by now
+    std::lock_guard lg(asyncLoopState.spillMutex);
+    auto&           spilled = asyncLoopState.spilledRequests;
+    if (spilled.empty())
+        return std::nullopt;
 
-        auto requests = asyncLoopState.requests;
-        asyncLoopState.requests.clear();
+    const auto      IT = std::ranges::max_element(spilled, {}, [](const auto& rq) { return rq.priority; });
+    SPreloadRequest rq = std::move(*IT);
+    spilled.erase(IT);
 
-        lk.unlock();
+    asyncLoopState.pending--;
+    return rq;
+}
 
-        // process requests
-        for (auto& r : requests) {
-            Debug::log(TRACE, "Processing requested resourceID {}", r.id);
+void CAsyncResourceGatherer::asyncAssetSpinLock(size_t workerIdx) {
+    while (!g_pHyprlock->m_bTerminate) {
+        auto rq = popRequest(workerIdx);
 
-            if (r.type == TARGET_TEXT) {
-                renderText(r);
-            } else if (r.type == TARGET_IMAGE) {
-                renderImage(r);
-            } else {
-                Debug::log(ERR, "Unsupported async preload type {}??", (int)r.type);
+        if (!rq) {
+            // pending is bumped before a request is pushed, so it might not be poppable just yet
+            if (asyncLoopState.pending > 0) {
+                std::this_thread::yield();
                 continue;
             }
 
-            // plant timer for callback
-            if (r.callback)
-                g_pHyprlock->addTimer(std::chrono::milliseconds(0), [cb = r.callback](auto, auto) { cb(); }, nullptr);
+            asyncLoopState.sleeping++;
+            {
+                std::unique_lock lk(asyncLoopState.requestsMutex);
+                asyncLoopState.requestsCV.wait_for(lk, std::chrono::seconds(5), [this] { return asyncLoopState.pending > 0 || g_pHyprlock->m_bTerminate; }); // wait for events
+            }
+            asyncLoopState.sleeping--;
+
+            continue;
+        }
+
+        Debug::log(TRACE, "Processing requested resourceID {} on worker {}", rq->id, workerIdx);
+
+        const auto JOBSTARTTP = std::chrono::system_clock::now();
+
+        if (rq->type == TARGET_TEXT) {
+            renderText(*rq);
+        } else if (rq->type == TARGET_IMAGE) {
+            // the initial images have to be complete for the first frame, no streaming
+            renderImage(*rq, !rq->initial);
+        } else {
+            Debug::log(ERR, "Unsupported async preload type {}??", (int)rq->type);
+            continue;
+        }
+
+        // gather() dispatches the callbacks once everything is in
+        if (rq->initial) {
+            Debug::log(LOG, "[gather] {} took {}ms", rq->asset, msSince(JOBSTARTTP));
+            addProgress(progress, initialLatch.progressPerJob);
+
+            std::lock_guard lg(initialLatch.mutex);
+            initialLatch.remaining--;
+            initialLatch.cv.notify_all();
+            continue;
         }
+
+        // plant timer for the callbacks of everyone waiting on this asset
+        g_pHyprlock->addTimer(std::chrono::milliseconds(0), [this, ID = rq->id](auto, auto) { dispatchCallbacks(ID); }, nullptr);
     }
 }
 
-void CAsyncResourceGatherer::requestAsyncAssetPreload(const SPreloadRequest& request) {
-    Debug::log(TRACE, "Requesting label resource {}", request.id);
+ResourceID CAsyncResourceGatherer::requestAsyncAssetPreload(const SPreloadRequest& rq) {
+    SPreloadRequest request = rq;
+    auto&           entry   = findOrAddAsset(request);
+    entry.refs++;
 
-    std::lock_guard<std::mutex> lg(asyncLoopState.requestsMutex);
-    asyncLoopState.requests.push_back(request);
-    asyncLoopState.pending = true;
-    asyncLoopState.requestsCV.notify_all();
+    if (entry.asset.ready || entry.pending) {
+        Debug::log(TRACE, "Sharing resource {} ({} refs)", request.id, entry.refs);
+
+        if (!request.callback)
+            return request.id;
+
+        if (entry.asset.ready)
+            g_pHyprlock->addTimer(std::chrono::milliseconds(0), [cb = request.callback](auto, auto) { cb(); }, nullptr);
+        else
+            entry.callbacks.emplace_back(request.callback);
+
+        return request.id;
+    }
+
+    entry.pending = true;
+    if (request.callback)
+        entry.callbacks.emplace_back(request.callback);
+
+    Debug::log(TRACE, "Requesting resource {}", request.id);
+
+    const auto ID = request.id;
+    enqueueRequest(std::move(request));
+
+    return ID;
 }
 
-void CAsyncResourceGatherer::unloadAsset(SPreloadedAsset* asset) {
-    std::erase_if(assets, [asset](const auto& a) { return &a.second == asset; });
+void CAsyncResourceGatherer::enqueueRequest(SPreloadRequest&& request) {
+    asyncLoopState.pending++;
+
+    // round robin, if a queue is full the next worker gets it
+    const size_t FIRSTWORKER = asyncLoopState.nextWorker++;
+    bool         queued      = false;
+    for (size_t i = 0; i < workers.size() && !queued; ++i) {
+        queued = workers[(FIRSTWORKER + i) % workers.size()]->queues[request.priority].push(std::move(request));
+    }
+
+    // a failed push leaves the request untouched
+    if (!queued) {
+        Debug::log(TRACE, "All worker queues are full, spilling resource {}", request.id);
+        std::lock_guard lg(asyncLoopState.spillMutex);
+        asyncLoopState.spilledRequests.emplace_back(std::move(request));
+    }
+
+    // only bother with the mutex if a worker might be asleep
+    if (asyncLoopState.sleeping > 0) {
+        std::lock_guard<std::mutex> lg(asyncLoopState.requestsMutex);
+        asyncLoopState.requestsCV.notify_one();
+    }
+}
+
+void CAsyncResourceGatherer::unloadAsset(ResourceID id) {
+    const auto IT = assets.find(id);
+    if (IT == assets.end())
+        return;
+
+    if (IT->second.refs > 0)
+        IT->second.refs--;
+
+    if (IT->second.refs == 0) {
+        if (!IT->second.key.empty())
+            assetIDs.erase(IT->second.key);
+
+        assets.erase(IT);
+    }
+}
+
+void CAsyncResourceGatherer::dispatchCallbacks(ResourceID id) {
+    apply();
+
+    const auto IT = assets.find(id);
+    if (IT == assets.end())
+        return;
+
+    // still streaming, streamUploads() dispatches again once the texture is complete
+    if (std::ranges::any_of(uploads, [id](const auto& u) { return u.target.id == id; }))
+        return;
+
+    // if the decode failed, the next request will try again
+    IT->second.pending = false;
+
+    const auto CALLBACKS = std::move(IT->second.callbacks);
+    IT->second.callbacks.clear();
+
+    for (const auto& cb : CALLBACKS) {
+        cb();
+    }
 }
 
 void CAsyncResourceGatherer::notify() {
+    for (auto& w : workers) {
+        for (auto& q : w->queues) {
+            asyncLoopState.pending -= q.drain([](SPreloadRequest&&) {});
+        }
+    }
+
+    {
+        std::lock_guard lg(asyncLoopState.spillMutex);
+        asyncLoopState.pending -= asyncLoopState.spilledRequests.size();
+        asyncLoopState.spilledRequests.clear();
+    }
+
+    {
+        std::lock_guard lg(scLatch.mutex);
+        scLatch.cv.notify_all();
+    }
+
+    {
+        std::lock_guard lg(initialLatch.mutex);
+        initialLatch.cv.notify_all();
+    }
+
     std::lock_guard<std::mutex> lg(asyncLoopState.requestsMutex);
-    asyncLoopState.requests.clear();
-    asyncLoopState.pending = true;
     asyncLoopState.requestsCV.notify_all();
 }
 
 void CAsyncResourceGatherer::await() {
     if (initialGatherThread.joinable())
         initialGatherThread.join();
-    if (asyncLoopThread.joinable())
-        asyncLoopThread.join();
+
+    for (auto& w : workers) {
+        if (w->thread.joinable())
+            w->thread.join();
+    }
 }
@@ -4,10 +4,12 @@
 #include <thread>
 #include <atomic>
 #include <vector>
+#include <optional>
 #include <unordered_map>
 #include <condition_variable>
 #include <any>
 #include "Shared.hpp"
+#include "../helpers/LockFreeQueue.hpp"
 #include <hyprgraphics/cairo/CairoSurface.hpp>
 #include <hyprutils/os/FileDescriptor.hpp>
 
@@ -20,19 +22,40 @@ class CAsyncResourceGatherer {
     std::atomic<float>             progress = 0;
 
     /* only call from ogl thread */
-    SPreloadedAsset* getAssetByID(const std::string& id);
+    SPreloadedAsset* getAssetByID(ResourceID id);
 
     bool             apply();
 
+    /* only call from ogl thread, once per frame.
+       Feeds large textures to the gpu in chunks. Returns true while some are still in flight. */
+    bool             streamUploads();
+
+    /* only call from the main thread, before locking.
+       Fails screencopy frames past their deadline. Returns the ms until the next deadline, -1 if no frame is pending. */
+    int64_t          expireScreencopyFrames();
+
+    /* only call from the main thread, daemon mode only.
+       Drops the last screenshots and captures the outputs again. gathered is reset until the new frames are in. */
+    void             recaptureScreencopy();
+
     enum eTargetType {
         TARGET_IMAGE = 0,
         TARGET_TEXT
     };
 
+    // Requests with a higher priority are picked up first by the workers.
+    enum ePriority {
+        PRIORITY_LOW = 0,
+        PRIORITY_NORMAL,
+        PRIORITY_HIGH,
+    };
+
     struct SPreloadRequest {
         eTargetType                               type;
         std::string                               asset;
-        std::string                               id;
+        ResourceID                                id       = 0; // set by requestAsyncAssetPreload
+        ePriority                                 priority = PRIORITY_NORMAL;
+        bool                                      initial  = false; // part of the initial gather, set by the gatherer
 
         std::unordered_map<std::string, std::any> props;
 
@@ -42,47 +65,118 @@ class CAsyncResourceGatherer {
         std::function<void()> callback = nullptr;
     };
 
-    void requestAsyncAssetPreload(const SPreloadRequest& request);
-    void unloadAsset(SPreloadedAsset* asset);
-    void notify();
-    void await();
+    // Assets are shared by content. Every request holds a reference to the returned id,
+    // which has to be given back with unloadAsset. Only call these from the main thread.
+    ResourceID requestAsyncAssetPreload(const SPreloadRequest& request);
+    void       unloadAsset(ResourceID id);
+
+    // the id of a loaded or pending asset with the same content, 0 if there is none. Takes no reference.
+    ResourceID findAsset(const SPreloadRequest& request) const;
+
+    void       notify();
+    void       await();
 
   private:
-    std::thread asyncLoopThread;
-    std::thread initialGatherThread;
+    // Each worker owns one queue per priority. Idle workers steal from the others,
+    // so one slow request (e.g. a hanging cmd[] label) does not hold up the rest.
+    struct SWorker {
+        std::thread                     thread;
+        CLockFreeQueue<SPreloadRequest> queues[PRIORITY_HIGH + 1] = {CLockFreeQueue<SPreloadRequest>{64}, CLockFreeQueue<SPreloadRequest>{64}, CLockFreeQueue<SPreloadRequest>{64}};
+    };
 
-    void        asyncAssetSpinLock();
-    void        renderText(const SPreloadRequest& rq);
-    void        renderImage(const SPreloadRequest& rq);
+    std::vector<UP<SWorker>>       workers;
+    std::thread                    initialGatherThread;
 
+    void                           asyncAssetSpinLock(size_t workerIdx);
+    void                           enqueueRequest(SPreloadRequest&& request);
+    std::optional<SPreloadRequest> popRequest(size_t workerIdx);
+    void                           renderText(const SPreloadRequest& rq);
+    void                           renderImage(const SPreloadRequest& rq, bool stream = true);
+
+    // requestsMutex is only taken to put idle workers to sleep and to wake them.
+    // Requests that find every worker queue full go to spilledRequests, so the main thread never waits on the workers.
     struct {
         std::condition_variable      requestsCV;
         std::mutex                   requestsMutex;
 
-        std::vector<SPreloadRequest> requests;
-        bool                         pending = false;
+        std::atomic<size_t>          pending    = 0;
+        std::atomic<size_t>          sleeping   = 0;
+        std::atomic<size_t>          nextWorker = 0;
 
-        bool                         busy = false;
+        std::mutex                   spillMutex;
+        std::vector<SPreloadRequest> spilledRequests;
     } asyncLoopState;
 
     struct SPreloadTarget {
         eTargetType                     type = TARGET_IMAGE;
-        std::string                     id   = "";
+        ResourceID                      id   = 0;
 
         void*                           data  = nullptr;
         void*                           cairo = nullptr;
         SP<Hyprgraphics::CCairoSurface> cairosurface;
 
         Vector2D                        size;
+
+        // false for the initial gather, those have to be complete for the first frame
+        bool stream = true;
     };
 
     std::vector<UP<CScreencopyFrame>>                scframes;
 
-    std::vector<SPreloadTarget>                      preloadTargets;
-    std::mutex                                       preloadTargetsMutex;
+    // counts down as screencopy frames finish, gather() waits for it to reach 0
+    struct {
+        std::condition_variable cv;
+        std::mutex              mutex;
+        size_t                  remaining = 0;
+    } scLatch;
+
+    // counts down as the workers finish the initial decodes, gather() waits for it to reach 0
+    struct {
+        std::condition_variable cv;
+        std::mutex              mutex;
+        size_t                  remaining      = 0;
+        float                   progressPerJob = 0;
+    } initialLatch;
+
+    // decoded assets, waiting for apply() to upload them. If the queue is full they go to spilledTargets,
+    // a worker never waits on the main thread, which might be waiting on the workers.
+    CLockFreeQueue<SPreloadTarget>                   preloadTargets{256};
+    std::mutex                                       spilledTargetsMutex;
+    std::vector<SPreloadTarget>                      spilledTargets;
+    void                                             pushTarget(SPreloadTarget&& target);
+
+    struct SAssetEntry {
+        SPreloadedAsset                    asset;
+        std::string                        key; // empty if never shared
+        size_t                             refs    = 0;
+        bool                               pending = false; // a decode is in flight
+        std::vector<std::function<void()>> callbacks;
+    };
+
+    // Ids are handed out in order and never reused, content is matched by the full key
+    std::unordered_map<ResourceID, SAssetEntry> assets;
+    std::unordered_map<std::string, ResourceID> assetIDs;
+    ResourceID                                  nextAssetID = 1;
+
+    static std::string                          assetKeyForRequest(const SPreloadRequest& request);
+    SAssetEntry&                                findOrAddAsset(SPreloadRequest& request);
+
+    // Targets above STREAMINGTHRESHOLD are not uploaded in one go. Their rows go through a pbo,
+    // UPLOADBUDGET bytes per frame, and the asset becomes ready once the fence after the last chunk signals.
+    struct SUpload {
+        SPreloadTarget target;
+        GLenum         format       = GL_RGBA;
+        GLenum         type         = GL_UNSIGNED_BYTE;
+        GLuint         pbo          = 0;
+        size_t         rowsUploaded = 0;
+        GLsync         fence        = nullptr;
+    };
 
-    std::unordered_map<std::string, SPreloadedAsset> assets;
+    static constexpr size_t STREAMINGTHRESHOLD = 4 * 1024 * 1024;
+    static constexpr size_t UPLOADBUDGET       = 8 * 1024 * 1024;
+    std::vector<SUpload>    uploads; // ogl thread only
 
-    void                                             gather();
-    void                                             enqueueScreencopyFrames();
+    void                    gather(const std::vector<SPreloadRequest>& requests);
+    void                    enqueueScreencopyFrames();
+    void                    dispatchCallbacks(ResourceID id);
 };
@@ -42,6 +42,7 @@ bool CFramebuffer::alloc(int w, int h, bool highres) {
     }
 
     if (firstAlloc || m_vSize != Vector2D(w, h)) {
+        m_cTex.m_vSize = {w, h};
         glBindTexture(GL_TEXTURE_2D, m_cTex.m_iTexID);
         glTexImage2D(GL_TEXTURE_2D, 0, glFormat, w, h, 0, GL_RGBA, glType, nullptr);
 
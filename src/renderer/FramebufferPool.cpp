@@ -0,0 +1,67 @@
+#include "FramebufferPool.hpp"
+#include "../helpers/Log.hpp"
+#include <algorithm>
+
+// A few outputs worth of blur mirrors and shadow targets
+constexpr size_t MAXIDLE = 8;
+
+CFramebufferPool::CLease::CLease(CFramebufferPool* pool, UP<CFramebuffer>&& fb, bool highres) : m_pool(pool), m_fb(std::move(fb)), m_highres(highres) {
+    ;
+}
+
+CFramebufferPool::CLease::CLease(CLease&& other) noexcept : m_pool(other.m_pool), m_fb(std::move(other.m_fb)), m_highres(other.m_highres) {
+    ;
+}
+
+CFramebufferPool::CLease::~CLease() {
+    if (m_fb)
+        m_pool->giveBack(std::move(m_fb), m_highres);
+}
+
+CFramebuffer* CFramebufferPool::CLease::get() const {
+    return m_fb.get();
+}
+
+CFramebuffer* CFramebufferPool::CLease::operator->() const {
+    return m_fb.get();
+}
+
+CFramebufferPool::CLease CFramebufferPool::lease(const Vector2D& size, bool highres) {
+    const auto IT = std::ranges::find_if(m_idle, [&](const auto& e) { return e.highres == highres && e.fb->m_vSize == size; });
+    if (IT != m_idle.end()) {
+        auto fb = std::move(IT->fb);
+        m_idle.erase(IT);
+        m_stats.hits++;
+        return CLease{this, std::move(fb), highres};
+    }
+
+    m_stats.misses++;
+    Debug::log(TRACE, "[fbpool] allocating {}x{}{} (hits {}, misses {})", size.x, size.y, highres ? " highres" : "", m_stats.hits, m_stats.misses);
+
+    auto fb = makeUnique<CFramebuffer>();
+    fb->alloc(size.x, size.y, highres);
+    return CLease{this, std::move(fb), highres};
+}
+
+void CFramebufferPool::giveBack(UP<CFramebuffer>&& fb, bool highres) {
+    m_idle.emplace_back(SEntry{.fb = std::move(fb), .highres = highres, .lastUsed = ++m_clock});
+
+    if (m_idle.size() <= MAXIDLE)
+        return;
+
+    const auto OLDEST = std::ranges::min_element(m_idle, {}, &SEntry::lastUsed);
+    m_idle.erase(OLDEST);
+    m_stats.evictions++;
+}
+
+void CFramebufferPool::trim() {
+    if (m_idle.empty())
+        return;
+
+    Debug::log(LOG, "[fbpool] freeing {} idle framebuffer(s) (hits {}, misses {}, evictions {})", m_idle.size(), m_stats.hits, m_stats.misses, m_stats.evictions);
+    m_idle.clear();
+}
+
+const CFramebufferPool::SStats& CFramebufferPool::stats() const {
+    return m_stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Framebuffer.hpp"
+#include "../defines.hpp"
+#include <cstdint>
+#include <vector>
+
+// Scratch framebuffers keyed by size and format.
+// Leased ones go back to the pool when the lease ends, so repeated blurs of the same size don't reallocate.
+class CFramebufferPool {
+  public:
+    class CLease {
+      public:
+        CLease(CFramebufferPool* pool, UP<CFramebuffer>&& fb, bool highres);
+        ~CLease();
+
+        CLease(CLease&& other) noexcept;
+        CLease(const CLease&)            = delete;
+        CLease& operator=(const CLease&) = delete;
+
+        CFramebuffer* get() const;
+        CFramebuffer* operator->() const;
+
+      private:
+        CFramebufferPool* m_pool = nullptr;
+        UP<CFramebuffer>  m_fb;
+        bool              m_highres = false;
+    };
+
+    struct SStats {
+        size_t hits      = 0;
+        size_t misses    = 0;
+        size_t evictions = 0;
+    };
+
+    /* only call from ogl thread.
+       The framebuffer is allocated at the given size, its contents are undefined. */
+    CLease        lease(const Vector2D& size, bool highres = false);
+
+    // frees all framebuffers that are not leased right now
+    void          trim();
+
+    const SStats& stats() const;
+
+  private:
+    struct SEntry {
+        UP<CFramebuffer> fb;
+        bool             highres  = false;
+        uint64_t         lastUsed = 0;
+    };
+
+    void                giveBack(UP<CFramebuffer>&& fb, bool highres);
+
+    std::vector<SEntry> m_idle;
+    SStats              m_stats;
+    uint64_t            m_clock = 0;
+};
@@ -0,0 +1,296 @@
+#include "GlyphAtlas.hpp"
+#include "../helpers/Log.hpp"
+#include <algorithm>
+#include <cairo/cairo.h>
+#include <cmath>
+
+constexpr int    ATLASSIZE     = 1024;
+constexpr int    GLYPHPAD      = 1;
+constexpr size_t MAXSHAPED     = 64;
+constexpr int    SUBPIXELSTEPS = 4; // glyph origins are kept to a quarter pixel
+
+PangoContext* createImageTextContext() {
+    const auto CONTEXT = pango_font_map_create_context(pango_cairo_font_map_get_default());
+
+    // pango_cairo_create_layout takes these from the surface, for image surfaces they turn on metrics hinting
+    const auto SURFACE = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+    const auto OPTIONS = cairo_font_options_create();
+    cairo_surface_get_font_options(SURFACE, OPTIONS);
+    pango_cairo_context_set_font_options(CONTEXT, OPTIONS);
+    cairo_font_options_destroy(OPTIONS);
+    cairo_surface_destroy(SURFACE);
+
+    return CONTEXT;
+}
+
+CGlyphAtlas::CGlyphAtlas(const std::string& fontFamily, int fontSize) {
+    context = createImageTextContext();
+    layout  = pango_layout_new(context);
+
+    PangoFontDescription* fontDesc = pango_font_description_from_string(fontFamily.c_str());
+    pango_font_description_set_size(fontDesc, fontSize * PANGO_SCALE);
+    pango_layout_set_font_description(layout, fontDesc);
+    pango_font_description_free(fontDesc);
+}
+
+CGlyphAtlas::~CGlyphAtlas() {
+    clear();
+    g_object_unref(layout);
+    g_object_unref(context);
+}
+
+void CGlyphAtlas::clear() {
+    for (const auto& [font, _] : glyphs) {
+        g_object_unref(font);
+    }
+
+    glyphs.clear();
+    shaped.clear();
+    shelfPos    = {};
+    shelfHeight = 0;
+    full        = false;
+}
+
+// Anything that changes how a glyph is colored or decorated needs the full pango/cairo path
+static bool onlyFontAttributes(PangoAttrList* attrList) {
+    if (!attrList)
+        return true;
+
+    bool    ok    = true;
+    GSList* attrs = pango_attr_list_get_attributes(attrList);
+    for (GSList* it = attrs; it; it = it->next) {
+        switch (((PangoAttribute*)it->data)->klass->type) {
+            case PANGO_ATTR_FAMILY:
+            case PANGO_ATTR_STYLE:
+            case PANGO_ATTR_WEIGHT:
+            case PANGO_ATTR_VARIANT:
+            case PANGO_ATTR_STRETCH:
+            case PANGO_ATTR_SIZE:
+            case PANGO_ATTR_FONT_DESC:
+            case PANGO_ATTR_ABSOLUTE_SIZE:
+            case PANGO_ATTR_SCALE:
+            case PANGO_ATTR_LETTER_SPACING:
+            case PANGO_ATTR_FALLBACK:
+            case PANGO_ATTR_FONT_FEATURES: break;
+            default: ok = false;
+        }
+    }
+
+    g_slist_free_full(attrs, (GDestroyNotify)pango_attribute_destroy);
+    return ok;
+}
+
+// Whole pixels go into the quad, the rest is rasterized into the glyph
+static std::pair<double, int> splitSubpixel(double pos) {
+    double whole = std::floor(pos);
+    int    step  = std::lround((pos - whole) * SUBPIXELSTEPS);
+    if (step == SUBPIXELSTEPS) {
+        whole += 1;
+        step = 0;
+    }
+
+    return {whole, step};
+}
+
+const CGlyphAtlas::SShapedText* CGlyphAtlas::shape(const std::string& text, const std::string& textAlign) {
+    const auto KEY = textAlign + '\n' + text;
+    if (const auto IT = shaped.find(KEY); IT != shaped.end())
+        return &IT->second;
+
+    PangoAttrList* attrList = nullptr;
+    char*          buf      = nullptr;
+    if (!pango_parse_markup(text.c_str(), -1, 0, &attrList, &buf, nullptr, nullptr))
+        return nullptr;
+
+    const bool DRAWABLE = onlyFontAttributes(attrList);
+    if (DRAWABLE) {
+        pango_layout_set_text(layout, buf, -1);
+        pango_layout_set_attributes(layout, attrList);
+    }
+
+    if (attrList)
+        pango_attr_list_unref(attrList);
+    g_free(buf);
+
+    if (!DRAWABLE)
+        return nullptr;
+
+    PangoAlignment align = PANGO_ALIGN_LEFT;
+    if (textAlign == "center")
+        align = PANGO_ALIGN_CENTER;
+    else if (textAlign == "right")
+        align = PANGO_ALIGN_RIGHT;
+    pango_layout_set_alignment(layout, align);
+
+    SShapedText result;
+    if (!shapeInto(result)) {
+        if (!full)
+            return nullptr;
+
+        // start over with only what this text needs
+        Debug::log(TRACE, "Glyph atlas full, clearing");
+        clear();
+        if (!shapeInto(result))
+            return nullptr;
+    }
+
+    if (shaped.size() >= MAXSHAPED)
+        shaped.clear();
+
+    return &(shaped[KEY] = std::move(result));
+}
+
+bool CGlyphAtlas::shapeInto(SShapedText& out) {
+    int layoutWidth, layoutHeight;
+    pango_layout_get_size(layout, &layoutWidth, &layoutHeight);
+    out.size = {layoutWidth / PANGO_SCALE, layoutHeight / PANGO_SCALE};
+
+    bool             ok   = true;
+    PangoLayoutIter* iter = pango_layout_get_iter(layout);
+    do {
+        const auto RUN = pango_layout_iter_get_run_readonly(iter);
+        if (!RUN)
+            continue; // end of a line
+
+        PangoRectangle logical;
+        pango_layout_iter_get_run_extents(iter, nullptr, &logical);
+        const int  BASELINE = pango_layout_iter_get_baseline(iter);
+        const auto FONT     = RUN->item->analysis.font;
+
+        int        penX = logical.x;
+        for (int i = 0; i < RUN->glyphs->num_glyphs && ok; ++i) {
+            const auto& INFO = RUN->glyphs->glyphs[i];
+            const int   X    = penX + INFO.geometry.x_offset;
+            penX += INFO.geometry.width;
+
+            if (INFO.glyph == PANGO_GLYPH_EMPTY)
+                continue;
+
+            const auto [ORIGINX, PHASEX] = splitSubpixel((double)X / PANGO_SCALE);
+            const auto [ORIGINY, PHASEY] = splitSubpixel((double)(BASELINE + INFO.geometry.y_offset) / PANGO_SCALE);
+
+            // every subpixel phase of a glyph is rasterized separately
+            const uint64_t KEY = (uint64_t)INFO.glyph | ((uint64_t)PHASEX << 32) | ((uint64_t)PHASEY << 40);
+
+            auto [fontIt, newFont] = glyphs.try_emplace(FONT);
+            if (newFont)
+                g_object_ref(FONT);
+
+            auto& fontGlyphs = fontIt->second;
+
+            auto it = fontGlyphs.find(KEY);
+            if (it == fontGlyphs.end()) {
+                const auto GLYPH = rasterize(FONT, INFO.glyph, Vector2D((double)PHASEX, (double)PHASEY));
+                if (!GLYPH) {
+                    ok = false;
+                    break;
+                }
+
+                it = fontGlyphs.emplace(KEY, *GLYPH).first;
+            }
+
+            const auto& GLYPH = it->second;
+            if (GLYPH.colored) {
+                ok = false;
+                break;
+            }
+
+            if (GLYPH.size.x <= 0 || GLYPH.size.y <= 0)
+                continue;
+
+            const float X0 = ORIGINX + GLYPH.bearing.x;
+            const float Y0 = ORIGINY + GLYPH.bearing.y;
+            out.quads.push_back(SGlyphQuad{
+                .box = {X0, Y0, (float)GLYPH.size.x, (float)GLYPH.size.y},
+                .uv  = {(float)(GLYPH.atlasPos.x / ATLASSIZE), (float)(GLYPH.atlasPos.y / ATLASSIZE), (float)(GLYPH.size.x / ATLASSIZE), (float)(GLYPH.size.y / ATLASSIZE)},
+            });
+        }
+    } while (ok && pango_layout_iter_next_run(iter));
+
+    pango_layout_iter_free(iter);
+    return ok;
+}
+
+std::optional<CGlyphAtlas::SGlyph> CGlyphAtlas::rasterize(PangoFont* font, PangoGlyph glyph, const Vector2D& phase) {
+    PangoRectangle ink;
+    pango_font_get_glyph_extents(font, glyph, &ink, nullptr);
+    pango_extents_to_pixels(&ink, nullptr);
+
+    if (ink.width <= 0 || ink.height <= 0)
+        return SGlyph{}; // whitespace
+
+    // one more pixel for what the subpixel offset pushes over the edge
+    const int W = ink.width + GLYPHPAD * 2 + (phase.x > 0 ? 1 : 0);
+    const int H = ink.height + GLYPHPAD * 2 + (phase.y > 0 ? 1 : 0);
+
+    if (shelfPos.x + W > ATLASSIZE) {
+        shelfPos    = {0, shelfPos.y + shelfHeight};
+        shelfHeight = 0;
+    }
+
+    if (W > ATLASSIZE || shelfPos.y + H > ATLASSIZE) {
+        full = true;
+        return std::nullopt;
+    }
+
+    const auto CAIROSURFACE = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, W, H);
+    const auto CAIRO        = cairo_create(CAIROSURFACE);
+
+    // white, so the cairo byte order does not matter and the shader can apply any color
+    cairo_set_source_rgba(CAIRO, 1, 1, 1, 1);
+    cairo_move_to(CAIRO, GLYPHPAD - ink.x + phase.x / SUBPIXELSTEPS, GLYPHPAD - ink.y + phase.y / SUBPIXELSTEPS);
+
+    PangoGlyphString* glyphString = pango_glyph_string_new();
+    pango_glyph_string_set_size(glyphString, 1);
+    glyphString->glyphs[0].glyph                 = glyph;
+    glyphString->glyphs[0].geometry              = {0, 0, 0};
+    glyphString->glyphs[0].attr.is_cluster_start = 1;
+    pango_cairo_show_glyph_string(CAIRO, font, glyphString);
+    pango_glyph_string_free(glyphString);
+
+    cairo_destroy(CAIRO);
+    cairo_surface_flush(CAIROSURFACE);
+
+    const auto DATA   = cairo_image_surface_get_data(CAIROSURFACE);
+    const int  STRIDE = cairo_image_surface_get_stride(CAIROSURFACE);
+
+    SGlyph     result;
+    result.bearing  = {ink.x - GLYPHPAD, ink.y - GLYPHPAD};
+    result.size     = {W, H};
+    result.atlasPos = shelfPos;
+
+    // emoji and other color glyphs can't be tinted
+    for (int y = 0; y < H && !result.colored; ++y) {
+        const auto ROW = DATA + (size_t)y * STRIDE;
+        for (int x = 0; x < W * 4; x += 4) {
+            if (ROW[x] != ROW[x + 3] || ROW[x + 1] != ROW[x + 3] || ROW[x + 2] != ROW[x + 3]) {
+                result.colored = true;
+                break;
+            }
+        }
+    }
+
+    if (!texture.m_bAllocated) {
+        texture.allocate();
+        glBindTexture(GL_TEXTURE_2D, texture.m_iTexID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, ATLASSIZE, ATLASSIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        texture.m_vSize = {ATLASSIZE, ATLASSIZE};
+    }
+
+    if (!result.colored) {
+        glBindTexture(GL_TEXTURE_2D, texture.m_iTexID);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, STRIDE / 4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, shelfPos.x, shelfPos.y, W, H, GL_RGBA, GL_UNSIGNED_BYTE, DATA);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        shelfPos.x += W;
+        shelfHeight = std::max(shelfHeight, H);
+    }
+
+    cairo_surface_destroy(CAIROSURFACE);
+
+    return result;
+}
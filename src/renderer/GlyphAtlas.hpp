@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Texture.hpp"
+#include "../helpers/Math.hpp"
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <pango/pangocairo.h>
+
+// A pango context that lays text out the way pango_cairo_create_layout does for an image surface,
+// so text from the atlas and from the asset gatherer gets the same hinting and metrics.
+PangoContext* createImageTextContext();
+
+// Glyphs of one font family and size, rasterized once and packed into a single texture.
+// Text that only changes a few characters (clocks, counters) is then just a couple of quads.
+class CGlyphAtlas {
+  public:
+    CGlyphAtlas(const std::string& fontFamily, int fontSize);
+    ~CGlyphAtlas();
+
+    CGlyphAtlas(const CGlyphAtlas&)            = delete;
+    CGlyphAtlas& operator=(const CGlyphAtlas&) = delete;
+
+    // x, y, w, h. Positions are in text pixels from the top left, uvs are normalized.
+    struct SGlyphQuad {
+        float box[4];
+        float uv[4];
+    };
+
+    struct SShapedText {
+        std::vector<SGlyphQuad> quads;
+        Vector2D                size;
+    };
+
+    /* only call from ogl thread.
+       Returns nullptr for text the atlas can't draw (colors, decorations, color glyphs, full atlas).
+       The result is valid until the next call. */
+    const SShapedText* shape(const std::string& text, const std::string& textAlign);
+
+    CTexture           texture;
+
+  private:
+    struct SGlyph {
+        Vector2D bearing; // ink offset from the pen position
+        Vector2D size;
+        Vector2D atlasPos;
+        bool     colored = false;
+    };
+
+    // phase is the subpixel offset of the glyph origin, in quarter pixels
+    std::optional<SGlyph>                                                rasterize(PangoFont* font, PangoGlyph glyph, const Vector2D& phase);
+    bool                                                                 shapeInto(SShapedText& out);
+    void                                                                 clear();
+
+    PangoContext*                                                        context = nullptr;
+    PangoLayout*                                                         layout  = nullptr;
+
+    std::unordered_map<PangoFont*, std::unordered_map<uint64_t, SGlyph>> glyphs; // by glyph and phase, holds a ref on every font
+    std::unordered_map<std::string, SShapedText>                         shaped;
+
+    // shelf packing, glyphs are put in rows left to right
+    Vector2D shelfPos;
+    int      shelfHeight = 0;
+    bool     full        = false;
+};
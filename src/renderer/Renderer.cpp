@@ -8,10 +8,15 @@
 #include "../core/hyprlock.hpp"
 #include "../helpers/Color.hpp"
 #include "../helpers/Log.hpp"
+#include "../helpers/MiscFunctions.hpp"
 #include <GLES3/gl32.h>
 #include <GLES3/gl3ext.h>
 #include <GLES2/gl2ext.h>
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
 #include "widgets/PasswordInputField.hpp"
 #include "widgets/Background.hpp"
 #include "widgets/Label.hpp"
@@ -27,7 +32,8 @@ inline const float fullVerts[] = {
     0, 1, // bottom left
 };
 
-GLuint compileShader(const GLuint& type, std::string src) {
+// dynamic: return 0 on failure instead of asserting, for threads other than the main one
+GLuint compileShader(const GLuint& type, std::string src, bool dynamic = false) {
     auto shader = glCreateShader(type);
 
     auto shaderSource = src.c_str();
@@ -38,23 +44,157 @@ GLuint compileShader(const GLuint& type, std::string src) {
     GLint ok;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
 
-    RASSERT(ok != GL_FALSE, "compileShader() failed! GL_COMPILE_STATUS not OK!");
+    RASSERT(dynamic || ok != GL_FALSE, "compileShader() failed! GL_COMPILE_STATUS not OK!");
+
+    if (ok == GL_FALSE) {
+        Debug::log(ERR, "compileShader() failed! GL_COMPILE_STATUS not OK!");
+        glDeleteShader(shader);
+        return 0;
+    }
 
     return shader;
 }
 
-GLuint createProgram(const std::string& vert, const std::string& frag) {
-    auto vertCompiled = compileShader(GL_VERTEX_SHADER, vert);
+struct SProgramCacheHeader {
+    uint32_t magic   = 0x42504c48; // HLPB
+    uint32_t version = 1;
+    uint64_t key     = 0;
+    uint32_t format  = 0;
+    uint32_t length  = 0;
+};
+
+// Program binaries are only valid for the driver that produced them
+static const std::string& driverID() {
+    static const std::string ID = [] {
+        const auto STR = [](GLenum name) {
+            const auto S = (const char*)glGetString(name);
+            return std::string{S ? S : ""};
+        };
+
+        return std::format("{}\n{}\n{}", STR(GL_VENDOR), STR(GL_RENDERER), STR(GL_VERSION));
+    }();
+
+    return ID;
+}
+
+static bool programBinariesSupported() {
+    static const bool SUPPORTED = [] {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0 && !getCacheDir().empty();
+    }();
+
+    return SUPPORTED;
+}
+
+static std::string programCacheFile(uint64_t key) {
+    return std::format("{}/shaders/{:016x}.bin", getCacheDir(), key);
+}
+
+static GLuint loadCachedProgram(uint64_t key) {
+    const auto    PATH = programCacheFile(key);
+    std::ifstream ifs(PATH, std::ios::binary);
+    if (!ifs.good())
+        return 0;
+
+    SProgramCacheHeader       header;
+    const SProgramCacheHeader EXPECTED{.key = key};
+    if (!ifs.read((char*)&header, sizeof(header)) || header.magic != EXPECTED.magic || header.version != EXPECTED.version || header.key != EXPECTED.key) {
+        Debug::log(WARN, "Ignoring invalid program cache {}", PATH);
+        return 0;
+    }
+
+    std::vector<char> binary(header.length);
+    if (!ifs.read(binary.data(), binary.size())) {
+        Debug::log(WARN, "Ignoring truncated program cache {}", PATH);
+        return 0;
+    }
+
+    auto prog = glCreateProgram();
+    glProgramBinary(prog, header.format, binary.data(), binary.size());
+
+    GLint ok;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (ok == GL_FALSE) {
+        // the driver may reject binaries after an update even if it reports the same version
+        Debug::log(LOG, "Driver rejected program cache {}, recompiling", PATH);
+        glDeleteProgram(prog);
+        std::error_code ec;
+        std::filesystem::remove(PATH, ec);
+        return 0;
+    }
+
+    return prog;
+}
+
+static void writeCachedProgram(GLuint prog, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    SProgramCacheHeader header{.key = key};
+    std::vector<char>   binary(length);
+    GLenum              format = 0;
+    glGetProgramBinary(prog, length, &length, &format, binary.data());
+    if (length <= 0)
+        return;
 
-    RASSERT(vertCompiled, "Compiling shader failed. VERTEX NULL! Shader source:\n\n{}", vert);
+    header.format = format;
+    header.length = length;
 
-    auto fragCompiled = compileShader(GL_FRAGMENT_SHADER, frag);
+    const std::filesystem::path CACHEPATH{programCacheFile(key)};
+    std::error_code             ec;
+    std::filesystem::create_directories(CACHEPATH.parent_path(), ec);
+
+    // same as the background cache, never let another instance read a partial file
+    const auto TMPPATH = CACHEPATH.string() + ".tmp";
+    {
+        std::ofstream ofs(TMPPATH, std::ios::binary | std::ios::trunc);
+        ofs.write((const char*)&header, sizeof(header));
+        ofs.write(binary.data(), header.length);
+        if (!ofs.good()) {
+            Debug::log(ERR, "Failed to write program cache {}", TMPPATH);
+            std::filesystem::remove(TMPPATH, ec);
+            return;
+        }
+    }
+
+    std::filesystem::rename(TMPPATH, CACHEPATH, ec);
+    if (ec)
+        Debug::log(ERR, "Failed to write program cache {}: {}", CACHEPATH.string(), ec.message());
+}
+
+GLuint createProgram(const std::string& vert, const std::string& frag, bool dynamic = false) {
+    const bool     CACHE = programBinariesSupported();
+    const uint64_t KEY   = CACHE ? std::hash<std::string>{}(driverID() + '\n' + vert + '\n' + frag) : 0;
+
+    if (CACHE) {
+        if (const auto PROG = loadCachedProgram(KEY); PROG)
+            return PROG;
+    }
 
-    RASSERT(fragCompiled, "Compiling shader failed. FRAGMENT NULL! Shader source:\n\n{}", frag);
+    auto vertCompiled = compileShader(GL_VERTEX_SHADER, vert, dynamic);
+
+    RASSERT(dynamic || vertCompiled, "Compiling shader failed. VERTEX NULL! Shader source:\n\n{}", vert);
+
+    if (!vertCompiled)
+        return 0;
+
+    auto fragCompiled = compileShader(GL_FRAGMENT_SHADER, frag, dynamic);
+
+    RASSERT(dynamic || fragCompiled, "Compiling shader failed. FRAGMENT NULL! Shader source:\n\n{}", frag);
+
+    if (!fragCompiled) {
+        glDeleteShader(vertCompiled);
+        return 0;
+    }
 
     auto prog = glCreateProgram();
     glAttachShader(prog, vertCompiled);
     glAttachShader(prog, fragCompiled);
+    if (CACHE)
+        glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(prog);
 
     glDetachShader(prog, vertCompiled);
@@ -65,11 +205,145 @@ GLuint createProgram(const std::string& vert, const std::string& frag) {
     GLint ok;
     glGetProgramiv(prog, GL_LINK_STATUS, &ok);
 
-    RASSERT(ok != GL_FALSE, "createProgram() failed! GL_LINK_STATUS not OK!");
+    RASSERT(dynamic || ok != GL_FALSE, "createProgram() failed! GL_LINK_STATUS not OK!");
+
+    if (ok == GL_FALSE) {
+        Debug::log(ERR, "createProgram() failed! GL_LINK_STATUS not OK!");
+        glDeleteProgram(prog);
+        return 0;
+    }
+
+    if (CACHE)
+        writeCachedProgram(prog, KEY);
+
+    return prog;
+}
+
+// Unlike the draw programs this may fail, callers fall back to something else
+static GLuint createComputeProgram(const std::string& src) {
+    const bool     CACHE = programBinariesSupported();
+    const uint64_t KEY   = CACHE ? std::hash<std::string>{}(driverID() + '\n' + src) : 0;
+
+    if (CACHE) {
+        if (const auto PROG = loadCachedProgram(KEY); PROG)
+            return PROG;
+    }
+
+    const auto SHADER = glCreateShader(GL_COMPUTE_SHADER);
+    const auto SOURCE = src.c_str();
+    glShaderSource(SHADER, 1, &SOURCE, nullptr);
+    glCompileShader(SHADER);
+
+    GLint ok;
+    glGetShaderiv(SHADER, GL_COMPILE_STATUS, &ok);
+    if (ok == GL_FALSE) {
+        std::string infoLog(1024, '\0');
+        GLsizei     length = 0;
+        glGetShaderInfoLog(SHADER, infoLog.size(), &length, infoLog.data());
+        infoLog.resize(length);
+
+        Debug::log(ERR, "Compiling compute shader failed: {}", infoLog);
+        glDeleteShader(SHADER);
+        return 0;
+    }
+
+    auto prog = glCreateProgram();
+    glAttachShader(prog, SHADER);
+    if (CACHE)
+        glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(prog);
+
+    glDetachShader(prog, SHADER);
+    glDeleteShader(SHADER);
+
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (ok == GL_FALSE) {
+        Debug::log(ERR, "Linking compute shader failed");
+        glDeleteProgram(prog);
+        return 0;
+    }
+
+    if (CACHE)
+        writeCachedProgram(prog, KEY);
 
     return prog;
 }
 
+struct SShaderSource {
+    const char*        name;
+    const std::string& vert;
+    const std::string& frag;
+};
+
+static const std::array<SShaderSource, CRenderer::SHADER_COUNT> SHADERSOURCES = {{
+    {"rect", QUADVERTSRC, QUADFRAGSRC},
+    {"texture", TEXVERTSRC, TEXFRAGSRCRGBA},
+    {"texture mix", TEXVERTSRC, TEXMIXFRAGSRCRGBA},
+    {"blur down", TEXVERTSRC, FRAGBLUR1},
+    {"blur up", TEXVERTSRC, FRAGBLUR2},
+    {"border", QUADVERTSRC, FRAGBORDER},
+    {"glyph", GLYPHVERTSRC, GLYPHFRAGSRC},
+}};
+
+// What the widget configs are going to draw with. Anything missed here is linked on first use.
+static std::vector<CRenderer::eShader> shadersForConfig() {
+    std::array<bool, CRenderer::SHADER_COUNT> needed = {};
+
+    const auto                                NEED = [&needed](std::initializer_list<CRenderer::eShader> shaders) {
+        for (const auto SHADER : shaders) {
+            needed[SHADER] = true;
+        }
+    };
+
+    const auto INTVAL = [](const CConfigManager::SWidgetConfig& c, const std::string& key) -> Hyprlang::INT {
+        const auto IT = c.values.find(key);
+        return IT == c.values.end() ? 0 : std::any_cast<Hyprlang::INT>(IT->second);
+    };
+
+    const auto BLUR = {CRenderer::SHADER_BLUR1, CRenderer::SHADER_BLUR2};
+
+    for (const auto& c : g_pConfigManager->getWidgetConfigs()) {
+        // shadows are blurred and then drawn as a texture
+        if (INTVAL(c, "shadow_passes") > 0) {
+            NEED(BLUR);
+            NEED({CRenderer::SHADER_TEX});
+        }
+
+        if (c.type == "background") {
+            const std::string PATH = std::any_cast<Hyprlang::STRING>(c.values.at("path"));
+            if (PATH.empty()) {
+                NEED({CRenderer::SHADER_RECT});
+                continue;
+            }
+
+            // crossfades from the screenshot and between reloaded images
+            NEED({CRenderer::SHADER_TEX, CRenderer::SHADER_TEXMIX});
+            if (INTVAL(c, "blur_passes") > 0)
+                NEED(BLUR);
+        } else if (c.type == "input-field") {
+            // placeholder and fail texts are drawn like labels
+            NEED({CRenderer::SHADER_RECT, CRenderer::SHADER_TEX, CRenderer::SHADER_GLYPH});
+            if (INTVAL(c, "outline_thickness") > 0)
+                NEED({CRenderer::SHADER_BORDER});
+        } else if (c.type == "label")
+            NEED({CRenderer::SHADER_TEX, CRenderer::SHADER_GLYPH});
+        else if (c.type == "shape" || c.type == "image") {
+            NEED({c.type == "shape" ? CRenderer::SHADER_RECT : CRenderer::SHADER_TEX});
+            if (INTVAL(c, "border_size") > 0)
+                NEED({CRenderer::SHADER_BORDER});
+        } else if (c.type == "pattern-lock")
+            NEED({CRenderer::SHADER_RECT});
+    }
+
+    std::vector<CRenderer::eShader> result;
+    for (size_t i = 0; i < needed.size(); ++i) {
+        if (needed[i])
+            result.push_back((CRenderer::eShader)i);
+    }
+
+    return result;
+}
+
 static void glMessageCallbackA(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam) {
     if (type != GL_DEBUG_TYPE_ERROR)
         return;
@@ -82,131 +356,245 @@ CRenderer::CRenderer() {
     glEnable(GL_DEBUG_OUTPUT);
     glDebugMessageCallback(glMessageCallbackA, nullptr);
 
-    GLuint prog          = createProgram(QUADVERTSRC, QUADFRAGSRC);
-    rectShader.program   = prog;
-    rectShader.proj      = glGetUniformLocation(prog, "proj");
-    rectShader.color     = glGetUniformLocation(prog, "color");
-    rectShader.posAttrib = glGetAttribLocation(prog, "pos");
-    rectShader.topLeft   = glGetUniformLocation(prog, "topLeft");
-    rectShader.fullSize  = glGetUniformLocation(prog, "fullSize");
-    rectShader.radius    = glGetUniformLocation(prog, "radius");
-
-    prog                        = createProgram(TEXVERTSRC, TEXFRAGSRCRGBA);
-    texShader.program           = prog;
-    texShader.proj              = glGetUniformLocation(prog, "proj");
-    texShader.tex               = glGetUniformLocation(prog, "tex");
-    texShader.alphaMatte        = glGetUniformLocation(prog, "texMatte");
-    texShader.alpha             = glGetUniformLocation(prog, "alpha");
-    texShader.texAttrib         = glGetAttribLocation(prog, "texcoord");
-    texShader.matteTexAttrib    = glGetAttribLocation(prog, "texcoordMatte");
-    texShader.posAttrib         = glGetAttribLocation(prog, "pos");
-    texShader.discardOpaque     = glGetUniformLocation(prog, "discardOpaque");
-    texShader.discardAlpha      = glGetUniformLocation(prog, "discardAlpha");
-    texShader.discardAlphaValue = glGetUniformLocation(prog, "discardAlphaValue");
-    texShader.topLeft           = glGetUniformLocation(prog, "topLeft");
-    texShader.fullSize          = glGetUniformLocation(prog, "fullSize");
-    texShader.radius            = glGetUniformLocation(prog, "radius");
-    texShader.applyTint         = glGetUniformLocation(prog, "applyTint");
-    texShader.tint              = glGetUniformLocation(prog, "tint");
-    texShader.useAlphaMatte     = glGetUniformLocation(prog, "useAlphaMatte");
-
-    prog                           = createProgram(TEXVERTSRC, TEXMIXFRAGSRCRGBA);
-    texMixShader.program           = prog;
-    texMixShader.proj              = glGetUniformLocation(prog, "proj");
-    texMixShader.tex               = glGetUniformLocation(prog, "tex1");
-    texMixShader.tex2              = glGetUniformLocation(prog, "tex2");
-    texMixShader.alphaMatte        = glGetUniformLocation(prog, "texMatte");
-    texMixShader.alpha             = glGetUniformLocation(prog, "alpha");
-    texMixShader.mixFactor         = glGetUniformLocation(prog, "mixFactor");
-    texMixShader.texAttrib         = glGetAttribLocation(prog, "texcoord");
-    texMixShader.matteTexAttrib    = glGetAttribLocation(prog, "texcoordMatte");
-    texMixShader.posAttrib         = glGetAttribLocation(prog, "pos");
-    texMixShader.discardOpaque     = glGetUniformLocation(prog, "discardOpaque");
-    texMixShader.discardAlpha      = glGetUniformLocation(prog, "discardAlpha");
-    texMixShader.discardAlphaValue = glGetUniformLocation(prog, "discardAlphaValue");
-    texMixShader.topLeft           = glGetUniformLocation(prog, "topLeft");
-    texMixShader.fullSize          = glGetUniformLocation(prog, "fullSize");
-    texMixShader.radius            = glGetUniformLocation(prog, "radius");
-    texMixShader.applyTint         = glGetUniformLocation(prog, "applyTint");
-    texMixShader.tint              = glGetUniformLocation(prog, "tint");
-    texMixShader.useAlphaMatte     = glGetUniformLocation(prog, "useAlphaMatte");
-
-    prog                          = createProgram(TEXVERTSRC, FRAGBLUR1);
-    blurShader1.program           = prog;
-    blurShader1.tex               = glGetUniformLocation(prog, "tex");
-    blurShader1.alpha             = glGetUniformLocation(prog, "alpha");
-    blurShader1.proj              = glGetUniformLocation(prog, "proj");
-    blurShader1.posAttrib         = glGetAttribLocation(prog, "pos");
-    blurShader1.texAttrib         = glGetAttribLocation(prog, "texcoord");
-    blurShader1.radius            = glGetUniformLocation(prog, "radius");
-    blurShader1.halfpixel         = glGetUniformLocation(prog, "halfpixel");
-    blurShader1.passes            = glGetUniformLocation(prog, "passes");
-    blurShader1.vibrancy          = glGetUniformLocation(prog, "vibrancy");
-    blurShader1.vibrancy_darkness = glGetUniformLocation(prog, "vibrancy_darkness");
-
-    prog                  = createProgram(TEXVERTSRC, FRAGBLUR2);
-    blurShader2.program   = prog;
-    blurShader2.tex       = glGetUniformLocation(prog, "tex");
-    blurShader2.alpha     = glGetUniformLocation(prog, "alpha");
-    blurShader2.proj      = glGetUniformLocation(prog, "proj");
-    blurShader2.posAttrib = glGetAttribLocation(prog, "pos");
-    blurShader2.texAttrib = glGetAttribLocation(prog, "texcoord");
-    blurShader2.radius    = glGetUniformLocation(prog, "radius");
-    blurShader2.halfpixel = glGetUniformLocation(prog, "halfpixel");
-
-    prog                         = createProgram(TEXVERTSRC, FRAGBLURPREPARE);
-    blurPrepareShader.program    = prog;
-    blurPrepareShader.tex        = glGetUniformLocation(prog, "tex");
-    blurPrepareShader.proj       = glGetUniformLocation(prog, "proj");
-    blurPrepareShader.posAttrib  = glGetAttribLocation(prog, "pos");
-    blurPrepareShader.texAttrib  = glGetAttribLocation(prog, "texcoord");
-    blurPrepareShader.contrast   = glGetUniformLocation(prog, "contrast");
-    blurPrepareShader.brightness = glGetUniformLocation(prog, "brightness");
-
-    prog                          = createProgram(TEXVERTSRC, FRAGBLURFINISH);
-    blurFinishShader.program      = prog;
-    blurFinishShader.tex          = glGetUniformLocation(prog, "tex");
-    blurFinishShader.proj         = glGetUniformLocation(prog, "proj");
-    blurFinishShader.posAttrib    = glGetAttribLocation(prog, "pos");
-    blurFinishShader.texAttrib    = glGetAttribLocation(prog, "texcoord");
-    blurFinishShader.brightness   = glGetUniformLocation(prog, "brightness");
-    blurFinishShader.noise        = glGetUniformLocation(prog, "noise");
-    blurFinishShader.colorize     = glGetUniformLocation(prog, "colorize");
-    blurFinishShader.colorizeTint = glGetUniformLocation(prog, "colorizeTint");
-    blurFinishShader.boostA       = glGetUniformLocation(prog, "boostA");
-
-    prog                               = createProgram(QUADVERTSRC, FRAGBORDER);
-    borderShader.program               = prog;
-    borderShader.proj                  = glGetUniformLocation(prog, "proj");
-    borderShader.thick                 = glGetUniformLocation(prog, "thick");
-    borderShader.posAttrib             = glGetAttribLocation(prog, "pos");
-    borderShader.texAttrib             = glGetAttribLocation(prog, "texcoord");
-    borderShader.topLeft               = glGetUniformLocation(prog, "topLeft");
-    borderShader.bottomRight           = glGetUniformLocation(prog, "bottomRight");
-    borderShader.fullSize              = glGetUniformLocation(prog, "fullSize");
-    borderShader.fullSizeUntransformed = glGetUniformLocation(prog, "fullSizeUntransformed");
-    borderShader.radius                = glGetUniformLocation(prog, "radius");
-    borderShader.radiusOuter           = glGetUniformLocation(prog, "radiusOuter");
-    borderShader.gradient              = glGetUniformLocation(prog, "gradient");
-    borderShader.gradientLength        = glGetUniformLocation(prog, "gradientLength");
-    borderShader.angle                 = glGetUniformLocation(prog, "angle");
-    borderShader.gradient2             = glGetUniformLocation(prog, "gradient2");
-    borderShader.gradient2Length       = glGetUniformLocation(prog, "gradient2Length");
-    borderShader.angle2                = glGetUniformLocation(prog, "angle2");
-    borderShader.gradientLerp          = glGetUniformLocation(prog, "gradientLerp");
-    borderShader.alpha                 = glGetUniformLocation(prog, "alpha");
+    startShaderCompiler(shadersForConfig());
 
     asyncResourceGatherer = makeUnique<CAsyncResourceGatherer>();
 
     g_pAnimationManager->createAnimation(0.f, opacity, g_pConfigManager->m_AnimationTree.getConfig("fadeIn"));
 }
 
+CRenderer::~CRenderer() {
+    if (shaderCompiler.thread.joinable())
+        shaderCompiler.thread.join();
+}
+
+void CRenderer::startShaderCompiler(const std::vector<eShader>& queue) {
+    if (queue.empty())
+        return;
+
+    // the compiler thread has no surface to make its context current with
+    const char* EXTS = eglQueryString(g_pEGL->eglDisplay, EGL_EXTENSIONS);
+    if (!EXTS || !std::string{EXTS}.contains("EGL_KHR_surfaceless_context")) {
+        Debug::log(WARN, "EGL_KHR_surfaceless_context not supported, linking shaders on first use");
+        return;
+    }
+
+    // a shared context, so the programs can be used by the main one
+    const EGLint CONTEXTATTRIBS[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+    const auto   CONTEXT          = eglCreateContext(g_pEGL->eglDisplay, g_pEGL->eglConfig, g_pEGL->eglContext, CONTEXTATTRIBS);
+    if (CONTEXT == EGL_NO_CONTEXT) {
+        Debug::log(WARN, "Failed to create a shared EGL context, linking shaders on first use");
+        return;
+    }
+
+    for (const auto SHADER : queue) {
+        shaderCompiler.queued[SHADER] = true;
+    }
+
+    shaderCompiler.thread = std::thread([this, CONTEXT, queue]() {
+        const auto STARTTP = std::chrono::system_clock::now();
+
+        // ensureShader links whatever is left at 0 on the main thread
+        if (eglMakeCurrent(g_pEGL->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, CONTEXT) != EGL_TRUE) {
+            Debug::log(ERR, "Failed to make the shader compiler context current (0x{:x}), linking shaders on first use", eglGetError());
+            eglDestroyContext(g_pEGL->eglDisplay, CONTEXT);
+
+            std::lock_guard lg(shaderCompiler.mutex);
+            for (const auto SHADER : queue) {
+                shaderCompiler.done[SHADER] = true;
+            }
+
+            shaderCompiler.cv.notify_all();
+            return;
+        }
+
+        for (const auto SHADER : queue) {
+            // never assert off the main thread
+            const auto PROG = createProgram(SHADERSOURCES[SHADER].vert, SHADERSOURCES[SHADER].frag, true);
+            // the main context may only use it once linking is done
+            glFinish();
+
+            std::lock_guard lg(shaderCompiler.mutex);
+            shaderCompiler.linked[SHADER] = PROG;
+            shaderCompiler.done[SHADER]   = true;
+            shaderCompiler.cv.notify_all();
+        }
+
+        eglMakeCurrent(g_pEGL->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(g_pEGL->eglDisplay, CONTEXT);
+
+        Debug::log(LOG, "Linked {} shader(s) in the background in {}ms", queue.size(),
+                   std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - STARTTP).count());
+    });
+}
+
+void CRenderer::ensureShader(eShader shader) {
+    if (shaderFor(shader).program)
+        return;
+
+    const auto& SRC  = SHADERSOURCES[shader];
+    GLuint      prog = 0;
+    if (shaderCompiler.queued[shader]) {
+        const auto       STARTWAITTP = std::chrono::system_clock::now();
+        std::unique_lock lk(shaderCompiler.mutex);
+        shaderCompiler.cv.wait(lk, [&] { return shaderCompiler.done[shader]; });
+        prog = shaderCompiler.linked[shader];
+
+        if (const auto WAITEDMS = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - STARTWAITTP).count(); WAITEDMS > 0)
+            Debug::log(LOG, "Waited {}ms for the {} shader", WAITEDMS, SRC.name);
+
+        if (!prog)
+            Debug::log(WARN, "The {} shader was not linked in the background, linking it now", SRC.name);
+    } else
+        Debug::log(LOG, "Linking the {} shader on first use", SRC.name);
+
+    if (!prog)
+        prog = createProgram(SRC.vert, SRC.frag);
+
+    setupShader(shader, prog);
+}
+
+CShader& CRenderer::shaderFor(eShader shader) {
+    switch (shader) {
+        case SHADER_RECT: return rectShader;
+        case SHADER_TEX: return texShader;
+        case SHADER_TEXMIX: return texMixShader;
+        case SHADER_BLUR1: return blurShader1;
+        case SHADER_BLUR2: return blurShader2;
+        case SHADER_BORDER: return borderShader;
+        default: return glyphShader;
+    }
+}
+
+void CRenderer::setupShader(eShader shader, GLuint prog) {
+    switch (shader) {
+        case SHADER_RECT: {
+            rectShader.program   = prog;
+            rectShader.proj      = glGetUniformLocation(prog, "proj");
+            rectShader.color     = glGetUniformLocation(prog, "color");
+            rectShader.posAttrib = glGetAttribLocation(prog, "pos");
+            rectShader.topLeft   = glGetUniformLocation(prog, "topLeft");
+            rectShader.fullSize  = glGetUniformLocation(prog, "fullSize");
+            rectShader.radius    = glGetUniformLocation(prog, "radius");
+        } break;
+
+        case SHADER_TEX: {
+            texShader.program           = prog;
+            texShader.proj              = glGetUniformLocation(prog, "proj");
+            texShader.tex               = glGetUniformLocation(prog, "tex");
+            texShader.alphaMatte        = glGetUniformLocation(prog, "texMatte");
+            texShader.alpha             = glGetUniformLocation(prog, "alpha");
+            texShader.texAttrib         = glGetAttribLocation(prog, "texcoord");
+            texShader.matteTexAttrib    = glGetAttribLocation(prog, "texcoordMatte");
+            texShader.posAttrib         = glGetAttribLocation(prog, "pos");
+            texShader.discardOpaque     = glGetUniformLocation(prog, "discardOpaque");
+            texShader.discardAlpha      = glGetUniformLocation(prog, "discardAlpha");
+            texShader.discardAlphaValue = glGetUniformLocation(prog, "discardAlphaValue");
+            texShader.topLeft           = glGetUniformLocation(prog, "topLeft");
+            texShader.fullSize          = glGetUniformLocation(prog, "fullSize");
+            texShader.radius            = glGetUniformLocation(prog, "radius");
+            texShader.applyTint         = glGetUniformLocation(prog, "applyTint");
+            texShader.tint              = glGetUniformLocation(prog, "tint");
+            texShader.useAlphaMatte     = glGetUniformLocation(prog, "useAlphaMatte");
+        } break;
+
+        case SHADER_TEXMIX: {
+            texMixShader.program           = prog;
+            texMixShader.proj              = glGetUniformLocation(prog, "proj");
+            texMixShader.tex               = glGetUniformLocation(prog, "tex1");
+            texMixShader.tex2              = glGetUniformLocation(prog, "tex2");
+            texMixShader.alphaMatte        = glGetUniformLocation(prog, "texMatte");
+            texMixShader.alpha             = glGetUniformLocation(prog, "alpha");
+            texMixShader.mixFactor         = glGetUniformLocation(prog, "mixFactor");
+            texMixShader.texAttrib         = glGetAttribLocation(prog, "texcoord");
+            texMixShader.matteTexAttrib    = glGetAttribLocation(prog, "texcoordMatte");
+            texMixShader.posAttrib         = glGetAttribLocation(prog, "pos");
+            texMixShader.discardOpaque     = glGetUniformLocation(prog, "discardOpaque");
+            texMixShader.discardAlpha      = glGetUniformLocation(prog, "discardAlpha");
+            texMixShader.discardAlphaValue = glGetUniformLocation(prog, "discardAlphaValue");
+            texMixShader.topLeft           = glGetUniformLocation(prog, "topLeft");
+            texMixShader.fullSize          = glGetUniformLocation(prog, "fullSize");
+            texMixShader.radius            = glGetUniformLocation(prog, "radius");
+            texMixShader.applyTint         = glGetUniformLocation(prog, "applyTint");
+            texMixShader.tint              = glGetUniformLocation(prog, "tint");
+            texMixShader.useAlphaMatte     = glGetUniformLocation(prog, "useAlphaMatte");
+        } break;
+
+        case SHADER_BLUR1: {
+            blurShader1.program           = prog;
+            blurShader1.tex               = glGetUniformLocation(prog, "tex");
+            blurShader1.alpha             = glGetUniformLocation(prog, "alpha");
+            blurShader1.proj              = glGetUniformLocation(prog, "proj");
+            blurShader1.posAttrib         = glGetAttribLocation(prog, "pos");
+            blurShader1.texAttrib         = glGetAttribLocation(prog, "texcoord");
+            blurShader1.radius            = glGetUniformLocation(prog, "radius");
+            blurShader1.halfpixel         = glGetUniformLocation(prog, "halfpixel");
+            blurShader1.passes            = glGetUniformLocation(prog, "passes");
+            blurShader1.vibrancy          = glGetUniformLocation(prog, "vibrancy");
+            blurShader1.vibrancy_darkness = glGetUniformLocation(prog, "vibrancy_darkness");
+            blurShader1.prepare           = glGetUniformLocation(prog, "prepare");
+            blurShader1.contrast          = glGetUniformLocation(prog, "contrast");
+            blurShader1.brightness        = glGetUniformLocation(prog, "brightness");
+        } break;
+
+        case SHADER_BLUR2: {
+            blurShader2.program      = prog;
+            blurShader2.tex          = glGetUniformLocation(prog, "tex");
+            blurShader2.alpha        = glGetUniformLocation(prog, "alpha");
+            blurShader2.proj         = glGetUniformLocation(prog, "proj");
+            blurShader2.posAttrib    = glGetAttribLocation(prog, "pos");
+            blurShader2.texAttrib    = glGetAttribLocation(prog, "texcoord");
+            blurShader2.radius       = glGetUniformLocation(prog, "radius");
+            blurShader2.halfpixel    = glGetUniformLocation(prog, "halfpixel");
+            blurShader2.finish       = glGetUniformLocation(prog, "finish");
+            blurShader2.noise        = glGetUniformLocation(prog, "noise");
+            blurShader2.brightness   = glGetUniformLocation(prog, "brightness");
+            blurShader2.colorize     = glGetUniformLocation(prog, "colorize");
+            blurShader2.colorizeTint = glGetUniformLocation(prog, "colorizeTint");
+            blurShader2.boostA       = glGetUniformLocation(prog, "boostA");
+        } break;
+
+        case SHADER_BORDER: {
+            borderShader.program               = prog;
+            borderShader.proj                  = glGetUniformLocation(prog, "proj");
+            borderShader.thick                 = glGetUniformLocation(prog, "thick");
+            borderShader.posAttrib             = glGetAttribLocation(prog, "pos");
+            borderShader.texAttrib             = glGetAttribLocation(prog, "texcoord");
+            borderShader.topLeft               = glGetUniformLocation(prog, "topLeft");
+            borderShader.bottomRight           = glGetUniformLocation(prog, "bottomRight");
+            borderShader.fullSize              = glGetUniformLocation(prog, "fullSize");
+            borderShader.fullSizeUntransformed = glGetUniformLocation(prog, "fullSizeUntransformed");
+            borderShader.radius                = glGetUniformLocation(prog, "radius");
+            borderShader.radiusOuter           = glGetUniformLocation(prog, "radiusOuter");
+            borderShader.gradient              = glGetUniformLocation(prog, "gradient");
+            borderShader.gradientLength        = glGetUniformLocation(prog, "gradientLength");
+            borderShader.angle                 = glGetUniformLocation(prog, "angle");
+            borderShader.gradient2             = glGetUniformLocation(prog, "gradient2");
+            borderShader.gradient2Length       = glGetUniformLocation(prog, "gradient2Length");
+            borderShader.angle2                = glGetUniformLocation(prog, "angle2");
+            borderShader.gradientLerp          = glGetUniformLocation(prog, "gradientLerp");
+            borderShader.alpha                 = glGetUniformLocation(prog, "alpha");
+        } break;
+
+        case SHADER_GLYPH: {
+            glyphShader.program        = prog;
+            glyphShader.proj           = glGetUniformLocation(prog, "proj");
+            glyphShader.tex            = glGetUniformLocation(prog, "tex");
+            glyphShader.color          = glGetUniformLocation(prog, "color");
+            glyphShader.posAttrib      = glGetAttribLocation(prog, "pos");
+            glyphShader.glyphBoxAttrib = glGetAttribLocation(prog, "glyphBox");
+            glyphShader.glyphUVAttrib  = glGetAttribLocation(prog, "glyphUV");
+        } break;
+        default: break;
+    }
+}
+
 //
 CRenderer::SRenderFeedback CRenderer::renderLock(const CSessionLockSurface& surf) {
-    projection = Mat3x3::outputProjection(surf.size, HYPRUTILS_TRANSFORM_NORMAL);
+    projection  = Mat3x3::outputProjection(surf.size, HYPRUTILS_TRANSFORM_NORMAL);
+    surfaceSize = surf.size;
 
     g_pEGL->makeCurrent(surf.eglSurface);
-    glViewport(0, 0, surf.size.x, surf.size.y);
 
     GLint fb = 0;
     glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fb);
@@ -218,6 +606,10 @@ CRenderer::SRenderFeedback CRenderer::renderLock(const CSessionLockSurface& surf
     glEnable(GL_BLEND);
     glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
+    // keep large texture uploads moving, a bit every frame
+    asyncResourceGatherer->apply();
+    const bool STREAMING = asyncResourceGatherer->streamUploads();
+
     SRenderFeedback feedback;
     const bool      WAITFORASSETS = !g_pHyprlock->m_bImmediateRender && !asyncResourceGatherer->gathered;
 
@@ -229,7 +621,7 @@ CRenderer::SRenderFeedback CRenderer::renderLock(const CSessionLockSurface& surf
         }
     }
 
-    feedback.needsFrame = feedback.needsFrame || !asyncResourceGatherer->gathered;
+    feedback.needsFrame = feedback.needsFrame || STREAMING || !asyncResourceGatherer->gathered;
 
     glDisable(GL_BLEND);
 
@@ -237,6 +629,8 @@ CRenderer::SRenderFeedback CRenderer::renderLock(const CSessionLockSurface& surf
 }
 
 void CRenderer::renderRect(const CBox& box, const CHyprColor& col, int rounding) {
+    ensureShader(SHADER_RECT);
+
     const auto ROUNDEDBOX = box.copy().round();
     Mat3x3     matrix     = projMatrix.projectBox(ROUNDEDBOX, HYPRUTILS_TRANSFORM_NORMAL, box.rot);
     Mat3x3     glMatrix   = projection.copy().multiply(matrix);
@@ -266,6 +660,8 @@ void CRenderer::renderRect(const CBox& box, const CHyprColor& col, int rounding)
 }
 
 void CRenderer::renderBorder(const CBox& box, const CGradientValueData& gradient, int thickness, int rounding, float alpha) {
+    ensureShader(SHADER_BORDER);
+
     const auto ROUNDEDBOX = box.copy().round();
     Mat3x3     matrix     = projMatrix.projectBox(ROUNDEDBOX, HYPRUTILS_TRANSFORM_NORMAL, box.rot);
     Mat3x3     glMatrix   = projection.copy().multiply(matrix);
@@ -303,6 +699,8 @@ void CRenderer::renderBorder(const CBox& box, const CGradientValueData& gradient
 }
 
 void CRenderer::renderTexture(const CBox& box, const CTexture& tex, float a, int rounding, std::optional<eTransform> tr) {
+    ensureShader(SHADER_TEX);
+
     const auto ROUNDEDBOX = box.copy().round();
     Mat3x3     matrix     = projMatrix.projectBox(ROUNDEDBOX, tr.value_or(HYPRUTILS_TRANSFORM_FLIPPED_180), box.rot);
     Mat3x3     glMatrix   = projection.copy().multiply(matrix);
@@ -344,6 +742,8 @@ void CRenderer::renderTexture(const CBox& box, const CTexture& tex, float a, int
 }
 
 void CRenderer::renderTextureMix(const CBox& box, const CTexture& tex, const CTexture& tex2, float a, float mixFactor, int rounding, std::optional<eTransform> tr) {
+    ensureShader(SHADER_TEXMIX);
+
     const auto ROUNDEDBOX = box.copy().round();
     Mat3x3     matrix     = projMatrix.projectBox(ROUNDEDBOX, tr.value_or(HYPRUTILS_TRANSFORM_FLIPPED_180), box.rot);
     Mat3x3     glMatrix   = projection.copy().multiply(matrix);
@@ -389,6 +789,51 @@ void CRenderer::renderTextureMix(const CBox& box, const CTexture& tex, const CTe
     glBindTexture(tex.m_iTarget, 0);
 }
 
+void CRenderer::renderGlyphs(const CTexture& atlas, const std::vector<CGlyphAtlas::SGlyphQuad>& quads, const CHyprColor& col) {
+    if (quads.empty())
+        return;
+
+    ensureShader(SHADER_GLYPH);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(atlas.m_iTarget, atlas.m_iTexID);
+
+    glUseProgram(glyphShader.program);
+
+    glUniformMatrix3fv(glyphShader.proj, 1, GL_TRUE, projection.getMatrix().data());
+    glUniform1i(glyphShader.tex, 0);
+    glUniform4f(glyphShader.color, col.r, col.g, col.b, col.a);
+
+    const auto STRIDE = sizeof(CGlyphAtlas::SGlyphQuad);
+    glVertexAttribPointer(glyphShader.posAttrib, 2, GL_FLOAT, GL_FALSE, 0, fullVerts);
+    glVertexAttribPointer(glyphShader.glyphBoxAttrib, 4, GL_FLOAT, GL_FALSE, STRIDE, quads.data()->box);
+    glVertexAttribPointer(glyphShader.glyphUVAttrib, 4, GL_FLOAT, GL_FALSE, STRIDE, quads.data()->uv);
+    glVertexAttribDivisor(glyphShader.glyphBoxAttrib, 1);
+    glVertexAttribDivisor(glyphShader.glyphUVAttrib, 1);
+
+    glEnableVertexAttribArray(glyphShader.posAttrib);
+    glEnableVertexAttribArray(glyphShader.glyphBoxAttrib);
+    glEnableVertexAttribArray(glyphShader.glyphUVAttrib);
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, quads.size());
+
+    glDisableVertexAttribArray(glyphShader.posAttrib);
+    glDisableVertexAttribArray(glyphShader.glyphBoxAttrib);
+    glDisableVertexAttribArray(glyphShader.glyphUVAttrib);
+    glVertexAttribDivisor(glyphShader.glyphBoxAttrib, 0);
+    glVertexAttribDivisor(glyphShader.glyphUVAttrib, 0);
+
+    glBindTexture(atlas.m_iTarget, 0);
+}
+
+CGlyphAtlas* CRenderer::getGlyphAtlas(const std::string& fontFamily, int fontSize) {
+    auto& atlas = glyphAtlases[std::format("{}:{}", fontFamily, fontSize)];
+    if (!atlas)
+        atlas = makeUnique<CGlyphAtlas>(fontFamily, fontSize);
+
+    return atlas.get();
+}
+
 template <class Widget>
 static void createWidget(std::vector<ASP<IWidget>>& widgets) {
     const auto W = makeAtomicShared<Widget>();
@@ -440,167 +885,324 @@ std::vector<ASP<IWidget>>& CRenderer::getOrCreateWidgetsFor(const CSessionLockSu
     return widgets[surf.m_outputID];
 }
 
+// Each kawase level adds r² / 2 (down) and r² / 3 (up) of variance in its own pixels, plus about a quarter pixel from resampling.
+// Only used to match the gaussian to the look of the kawase chain.
+static float kawaseSigma(int size, int passes) {
+    const float LEVELVAR = 5.f * size * size / 6.f + 0.25f;
+    return std::sqrt(LEVELVAR * (std::pow(4.f, passes) - 1.f) / 3.f);
+}
+
+int CRenderer::blurSpread(int size, int passes) {
+    return (int)std::ceil(3.f * kawaseSigma(size, std::max(passes, 1)));
+}
+
 void CRenderer::blurFB(const CFramebuffer& outfb, SBlurParams params) {
+    static const auto BLURENGINE = g_pConfigManager->getValue<Hyprlang::INT>("general:blur_engine");
+
     glDisable(GL_BLEND);
     glDisable(GL_STENCIL_TEST);
 
-    CBox box{0, 0, outfb.m_vSize.x, outfb.m_vSize.y};
-    box.round();
-    Mat3x3       matrix   = projMatrix.projectBox(box, HYPRUTILS_TRANSFORM_NORMAL, 0);
-    Mat3x3       glMatrix = projection.copy().multiply(matrix);
+    // vibrancy works on the intermediate kawase levels, the gaussian has nothing like that
+    if (*BLURENGINE == 1 && params.vibrancy == 0.f && computeBlurSupported())
+        blurFBCompute(outfb, params);
+    else
+        blurFBKawase(outfb, params);
+
+    glEnable(GL_BLEND);
+}
+
+void CRenderer::blurFBKawase(const CFramebuffer& outfb, const SBlurParams& params) {
+    ensureShader(SHADER_BLUR1);
+    ensureShader(SHADER_BLUR2);
+
+    // prepare and finish are part of the first and last pass, so there has to be at least one of each
+    const int PASSES = std::max(params.passes, 1);
+
+    // Level 0 is outfb itself, every level below is half the size of the one above.
+    // Only the last up pass touches every pixel of outfb.
+    std::vector<CFramebufferPool::CLease> leases;
+    std::vector<const CFramebuffer*>      levels = {&outfb};
+    leases.reserve(PASSES);
+    for (int i = 1; i <= PASSES; ++i) {
+        const auto& ABOVE = levels.back()->m_vSize;
+        leases.emplace_back(fbPool.lease({std::max(1.0, std::floor(ABOVE.x / 2.0)), std::max(1.0, std::floor(ABOVE.y / 2.0))}, true));
+        levels.push_back(leases.back().get());
+    }
 
-    CFramebuffer mirrors[2];
-    mirrors[0].alloc(outfb.m_vSize.x, outfb.m_vSize.y, true);
-    mirrors[1].alloc(outfb.m_vSize.x, outfb.m_vSize.y, true);
+    // down
+    glUseProgram(blurShader1.program);
+    glUniform1i(blurShader1.passes, params.passes);
+    glUniform1f(blurShader1.vibrancy, params.vibrancy);
+    glUniform1f(blurShader1.vibrancy_darkness, params.vibrancy_darkness);
+    glUniform1f(blurShader1.contrast, params.contrast);
+    glUniform1f(blurShader1.brightness, params.brightness);
+    for (int i = 1; i <= PASSES; ++i) {
+        glUniform1i(blurShader1.prepare, i == 1);
+        blurPass(blurShader1, levels[i - 1]->m_cTex, *levels[i], params.size);
+    }
 
-    CFramebuffer* currentRenderToFB = &mirrors[0];
+    // up, the last pass writes straight into outfb
+    useBlurFinish(params);
+    for (int i = PASSES; i >= 1; --i) {
+        glUniform1i(blurShader2.finish, i == 1);
+        blurPass(blurShader2, levels[i]->m_cTex, *levels[i - 1], params.size);
+    }
+}
 
-    // Begin with base color adjustments - global brightness and contrast
-    // TODO: make this a part of the first pass maybe to save on a drawcall?
-    {
-        mirrors[1].bind();
+constexpr int COMPUTEBLURTILE      = 256; // keep in sync with COMPUTEBLUR
+constexpr int COMPUTEBLURMAXRADIUS = 48;
 
-        glActiveTexture(GL_TEXTURE0);
+void CRenderer::blurFBCompute(const CFramebuffer& outfb, const SBlurParams& params) {
+    ensureShader(SHADER_BLUR2);
 
-        glBindTexture(outfb.m_cTex.m_iTarget, outfb.m_cTex.m_iTexID);
+    const float SIGMA = kawaseSigma(params.size, std::max(params.passes, 1));
 
-        glTexParameteri(outfb.m_cTex.m_iTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // Blur a mip level small enough for the kernel to fit into MAXRADIUS taps.
+    // The upscale afterwards is invisible next to a blur that wide.
+    const int MAXLOD = (int)std::floor(std::log2(std::max(1.0, std::min(outfb.m_vSize.x, outfb.m_vSize.y))));
+    int       lod    = 0;
+    while (lod < MAXLOD && std::ceil(3.f * SIGMA / (1 << lod)) > COMPUTEBLURMAXRADIUS) {
+        lod++;
+    }
 
-        glUseProgram(blurPrepareShader.program);
+    const int   W        = std::max(1, (int)outfb.m_vSize.x >> lod);
+    const int   H        = std::max(1, (int)outfb.m_vSize.y >> lod);
+    const float LODSIGMA = SIGMA / (1 << lod);
+    const int   RADIUS   = std::clamp((int)std::ceil(3.f * LODSIGMA), 1, COMPUTEBLURMAXRADIUS);
 
-        glUniformMatrix3fv(blurPrepareShader.proj, 1, GL_TRUE, glMatrix.getMatrix().data());
-        glUniform1f(blurPrepareShader.contrast, params.contrast);
-        glUniform1f(blurPrepareShader.brightness, params.brightness);
-        glUniform1i(blurPrepareShader.tex, 0);
+    std::array<float, COMPUTEBLURMAXRADIUS + 1> weights   = {};
+    float                                       weightSum = 0;
+    for (int i = 0; i <= RADIUS; ++i) {
+        weights[i] = std::exp(-(float)(i * i) / (2.f * LODSIGMA * LODSIGMA));
+        weightSum += i == 0 ? weights[i] : 2.f * weights[i];
+    }
 
-        glVertexAttribPointer(blurPrepareShader.posAttrib, 2, GL_FLOAT, GL_FALSE, 0, fullVerts);
-        glVertexAttribPointer(blurPrepareShader.texAttrib, 2, GL_FLOAT, GL_FALSE, 0, fullVerts);
+    for (auto& w : weights) {
+        w /= weightSum;
+    }
 
-        glEnableVertexAttribArray(blurPrepareShader.posAttrib);
-        glEnableVertexAttribArray(blurPrepareShader.texAttrib);
+    for (auto& tex : computeBlur.textures) {
+        if (tex.m_bAllocated && tex.m_vSize == Vector2D(W, H))
+            continue;
+
+        tex.destroyTexture();
+        tex.allocate();
+        tex.m_vSize = {W, H};
+        glBindTexture(GL_TEXTURE_2D, tex.m_iTexID);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, W, H);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    }
 
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    auto dispatchPass = [&](CShader& shader, const CTexture& dst, int srcLod, int along, int lines) {
+        glUniform1i(shader.tex, 0);
+        glUniform1i(shader.getUniformLocation("lod"), srcLod);
+        glUniform2i(shader.getUniformLocation("size"), W, H);
+        glUniform1i(shader.radius, RADIUS);
+        glUniform1fv(shader.getUniformLocation("weights"), RADIUS + 1, weights.data());
 
-        glDisableVertexAttribArray(blurPrepareShader.posAttrib);
-        glDisableVertexAttribArray(blurPrepareShader.texAttrib);
+        glBindImageTexture(0, dst.m_iTexID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute((along + COMPUTEBLURTILE - 1) / COMPUTEBLURTILE, lines, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    };
 
-        currentRenderToFB = &mirrors[1];
+    // horizontal, from outfb
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, outfb.m_cTex.m_iTexID);
+    if (lod > 0) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glGenerateMipmap(GL_TEXTURE_2D);
     }
 
-    // declare the draw func
-    auto drawPass = [&](CShader* pShader) {
-        if (currentRenderToFB == &mirrors[0])
-            mirrors[1].bind();
-        else
-            mirrors[0].bind();
+    glUseProgram(computeBlur.horizontal.program);
+    glUniform1f(computeBlur.horizontal.contrast, params.contrast);
+    glUniform1f(computeBlur.horizontal.brightness, params.brightness);
+    dispatchPass(computeBlur.horizontal, computeBlur.textures[0], lod, W, H);
 
-        glActiveTexture(GL_TEXTURE0);
+    if (lod > 0)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-        glBindTexture(currentRenderToFB->m_cTex.m_iTarget, currentRenderToFB->m_cTex.m_iTexID);
+    // vertical
+    glBindTexture(GL_TEXTURE_2D, computeBlur.textures[0].m_iTexID);
+    glUseProgram(computeBlur.vertical.program);
+    dispatchPass(computeBlur.vertical, computeBlur.textures[1], 0, H, W);
 
-        glTexParameteri(currentRenderToFB->m_cTex.m_iTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // back to full size, with the same finish as the kawase chain
+    useBlurFinish(params);
+    glUniform1i(blurShader2.finish, 1);
+    blurPass(blurShader2, computeBlur.textures[1], outfb, 0.f);
+}
 
-        glUseProgram(pShader->program);
+void CRenderer::blurPass(CShader& shader, const CTexture& src, const CFramebuffer& dst, float radius) {
+    dst.bind();
 
-        // prep two shaders
-        glUniformMatrix3fv(pShader->proj, 1, GL_TRUE, glMatrix.getMatrix().data());
-        glUniform1f(pShader->radius, params.size);
-        if (pShader == &blurShader1) {
-            glUniform2f(blurShader1.halfpixel, 0.5f / (outfb.m_vSize.x / 2.f), 0.5f / (outfb.m_vSize.y / 2.f));
-            glUniform1i(blurShader1.passes, params.passes);
-            glUniform1f(blurShader1.vibrancy, params.vibrancy);
-            glUniform1f(blurShader1.vibrancy_darkness, params.vibrancy_darkness);
-        } else
-            glUniform2f(blurShader2.halfpixel, 0.5f / (outfb.m_vSize.x * 2.f), 0.5f / (outfb.m_vSize.y * 2.f));
-        glUniform1i(pShader->tex, 0);
+    const CBox   BOX{0, 0, dst.m_vSize.x, dst.m_vSize.y};
+    const Mat3x3 GLMATRIX = Mat3x3::outputProjection(dst.m_vSize, HYPRUTILS_TRANSFORM_NORMAL).multiply(projMatrix.projectBox(BOX, HYPRUTILS_TRANSFORM_NORMAL, 0));
 
-        glVertexAttribPointer(pShader->posAttrib, 2, GL_FLOAT, GL_FALSE, 0, fullVerts);
-        glVertexAttribPointer(pShader->texAttrib, 2, GL_FLOAT, GL_FALSE, 0, fullVerts);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(src.m_iTarget, src.m_iTexID);
+    glTexParameteri(src.m_iTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-        glEnableVertexAttribArray(pShader->posAttrib);
-        glEnableVertexAttribArray(pShader->texAttrib);
+    glUniformMatrix3fv(shader.proj, 1, GL_TRUE, GLMATRIX.getMatrix().data());
+    glUniform1f(shader.radius, radius);
+    glUniform2f(shader.halfpixel, 0.5f / dst.m_vSize.x, 0.5f / dst.m_vSize.y);
+    glUniform1i(shader.tex, 0);
 
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glVertexAttribPointer(shader.posAttrib, 2, GL_FLOAT, GL_FALSE, 0, fullVerts);
+    glVertexAttribPointer(shader.texAttrib, 2, GL_FLOAT, GL_FALSE, 0, fullVerts);
 
-        glDisableVertexAttribArray(pShader->posAttrib);
-        glDisableVertexAttribArray(pShader->texAttrib);
+    glEnableVertexAttribArray(shader.posAttrib);
+    glEnableVertexAttribArray(shader.texAttrib);
 
-        if (currentRenderToFB != &mirrors[0])
-            currentRenderToFB = &mirrors[0];
-        else
-            currentRenderToFB = &mirrors[1];
-    };
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glDisableVertexAttribArray(shader.posAttrib);
+    glDisableVertexAttribArray(shader.texAttrib);
+}
 
-    // draw the things.
-    // first draw is swap -> mirr
-    mirrors[0].bind();
-    glBindTexture(mirrors[1].m_cTex.m_iTarget, mirrors[1].m_cTex.m_iTexID);
+void CRenderer::useBlurFinish(const SBlurParams& params) {
+    glUseProgram(blurShader2.program);
+    glUniform1f(blurShader2.noise, params.noise);
+    glUniform1f(blurShader2.brightness, params.brightness);
+    glUniform1i(blurShader2.colorize, params.colorize.has_value());
+    if (params.colorize.has_value())
+        glUniform3f(blurShader2.colorizeTint, params.colorize->r, params.colorize->g, params.colorize->b);
+    glUniform1f(blurShader2.boostA, params.boostA);
+}
+
+bool CRenderer::computeBlurSupported() {
+    if (computeBlur.checked)
+        return computeBlur.supported;
+
+    computeBlur.checked = true;
 
-    for (int i = 1; i <= params.passes; ++i) {
-        drawPass(&blurShader1); // down
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major < 3 || (major == 3 && minor < 1)) {
+        Debug::log(WARN, "blur_engine = 1 needs GLES 3.1, got {}.{}. Using the kawase blur instead", major, minor);
+        return false;
     }
 
-    for (int i = params.passes - 1; i >= 0; --i) {
-        drawPass(&blurShader2); // up
+    for (int direction = 0; direction < 2; ++direction) {
+        auto& shader = direction == 0 ? computeBlur.horizontal : computeBlur.vertical;
+
+        shader.program = createComputeProgram(std::format("#version 310 es\n#define DIRECTION {}\n{}", direction, COMPUTEBLUR));
+        if (!shader.program) {
+            Debug::log(WARN, "Using the kawase blur instead");
+            return false;
+        }
+
+        shader.tex        = glGetUniformLocation(shader.program, "tex");
+        shader.radius     = glGetUniformLocation(shader.program, "radius");
+        shader.contrast   = glGetUniformLocation(shader.program, "contrast");
+        shader.brightness = glGetUniformLocation(shader.program, "brightness");
     }
 
-    // finalize the image
-    {
-        if (currentRenderToFB == &mirrors[0])
-            mirrors[1].bind();
-        else
-            mirrors[0].bind();
+    computeBlur.supported = true;
+    return true;
+}
 
-        glActiveTexture(GL_TEXTURE0);
+void CRenderer::benchmarkBlur() {
+    constexpr int RUNS = 10;
 
-        glBindTexture(currentRenderToFB->m_cTex.m_iTarget, currentRenderToFB->m_cTex.m_iTexID);
+    struct SCase {
+        int size, passes;
+    };
 
-        glTexParameteri(currentRenderToFB->m_cTex.m_iTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // the default, and what people tend to set for frosted glass
+    constexpr std::array<SCase, 5> CASES = {{{4, 2}, {8, 1}, {8, 3}, {10, 4}, {20, 4}}};
 
-        glUseProgram(blurFinishShader.program);
+    CFramebuffer                   fb;
+    fb.alloc(3840, 2160);
+    fb.bind();
+    glClearColor(0.2, 0.4, 0.6, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-        glUniformMatrix3fv(blurFinishShader.proj, 1, GL_TRUE, glMatrix.getMatrix().data());
-        glUniform1f(blurFinishShader.noise, params.noise);
-        glUniform1f(blurFinishShader.brightness, params.brightness);
-        glUniform1i(blurFinishShader.colorize, params.colorize.has_value());
-        if (params.colorize.has_value())
-            glUniform3f(blurFinishShader.colorizeTint, params.colorize->r, params.colorize->g, params.colorize->b);
-        glUniform1f(blurFinishShader.boostA, params.boostA);
+    glDisable(GL_BLEND);
+    glDisable(GL_STENCIL_TEST);
 
-        glUniform1i(blurFinishShader.tex, 0);
+    const auto TIMEMS = [&](auto&& blur) {
+        // once to link programs and allocate scratch targets
+        blur();
+        glFinish();
 
-        glVertexAttribPointer(blurFinishShader.posAttrib, 2, GL_FLOAT, GL_FALSE, 0, fullVerts);
-        glVertexAttribPointer(blurFinishShader.texAttrib, 2, GL_FLOAT, GL_FALSE, 0, fullVerts);
+        const auto STARTTP = std::chrono::steady_clock::now();
+        for (int i = 0; i < RUNS; ++i) {
+            blur();
+        }
+        glFinish();
 
-        glEnableVertexAttribArray(blurFinishShader.posAttrib);
-        glEnableVertexAttribArray(blurFinishShader.texAttrib);
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - STARTTP).count() / RUNS;
+    };
 
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    const bool COMPUTE = computeBlurSupported();
+    for (const auto& c : CASES) {
+        const SBlurParams PARAMS{.size = c.size, .passes = c.passes, .contrast = 1.f, .brightness = 1.f};
 
-        glDisableVertexAttribArray(blurFinishShader.posAttrib);
-        glDisableVertexAttribArray(blurFinishShader.texAttrib);
+        const auto        KAWASEMS = TIMEMS([&] { blurFBKawase(fb, PARAMS); });
+        if (!COMPUTE) {
+            Debug::log(LOG, "[blur benchmark] blur_size {} blur_passes {}: kawase {:.2f}ms", c.size, c.passes, KAWASEMS);
+            continue;
+        }
 
-        if (currentRenderToFB != &mirrors[0])
-            currentRenderToFB = &mirrors[0];
-        else
-            currentRenderToFB = &mirrors[1];
+        const auto COMPUTEMS = TIMEMS([&] { blurFBCompute(fb, PARAMS); });
+        Debug::log(LOG, "[blur benchmark] blur_size {} blur_passes {} (sigma {:.1f}px): kawase {:.2f}ms, compute {:.2f}ms", c.size, c.passes, kawaseSigma(c.size, c.passes),
+                   KAWASEMS, COMPUTEMS);
     }
 
-    // finish
-    outfb.bind();
-    renderTexture(box, currentRenderToFB->m_cTex, 1.0, 0, HYPRUTILS_TRANSFORM_NORMAL);
-
     glEnable(GL_BLEND);
+    fbPool.trim();
 }
 
-void CRenderer::pushFb(GLint fb) {
-    boundFBs.push_back(fb);
+SP<CFramebuffer> CRenderer::getSharedBlur(const std::string& key) {
+    const auto IT = sharedBlurs.find(key);
+    if (IT == sharedBlurs.end())
+        return nullptr;
+
+    if (IT->second.expired()) {
+        sharedBlurs.erase(IT);
+        return nullptr;
+    }
+
+    return IT->second.lock();
+}
+
+void CRenderer::addSharedBlur(const std::string& key, const SP<CFramebuffer>& fb) {
+    std::erase_if(sharedBlurs, [](const auto& e) { return e.second.expired(); });
+    sharedBlurs[key] = fb;
+}
+
+void CRenderer::pushFb(GLint fb, const Vector2D& origin) {
+    boundFBs.push_back({fb, origin});
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fb);
+    glViewport(-origin.x, -origin.y, surfaceSize.x, surfaceSize.y);
 }
 
 void CRenderer::popFb() {
     boundFBs.pop_back();
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, boundFBs.empty() ? 0 : boundFBs.back());
+    if (boundFBs.empty()) {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        return;
+    }
+
+    // blurs and nested framebuffers change the viewport
+    const auto& BOUND = boundFBs.back();
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, BOUND.fb);
+    glViewport(-BOUND.origin.x, -BOUND.origin.y, surfaceSize.x, surfaceSize.y);
+}
+
+void CRenderer::scissor(const CBox* box) {
+    if (!box) {
+        glDisable(GL_SCISSOR_TEST);
+        return;
+    }
+
+    const auto ORIGIN = boundFBs.empty() ? Vector2D{} : boundFBs.back().origin;
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(box->x - ORIGIN.x, box->y - ORIGIN.y, box->w, box->h);
 }
 
 void CRenderer::removeWidgetsFor(OUTPUTID id) {
@@ -616,6 +1218,8 @@ void CRenderer::reconfigureWidgetsFor(OUTPUTID id) {
 
 void CRenderer::startFadeIn() {
     Debug::log(LOG, "Starting fade in");
+    // a previous lock of the daemon left the fadeOut config behind
+    opacity->setConfig(g_pConfigManager->m_AnimationTree.getConfig("fadeIn"));
     *opacity = 1.f;
 
     opacity->setCallbackOnEnd([this](auto) { opacity->setConfig(g_pConfigManager->m_AnimationTree.getConfig("fadeOut")); }, true);
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <optional>
+#include <thread>
 #include "Shader.hpp"
 #include "../defines.hpp"
 #include "../core/LockSurface.hpp"
@@ -11,12 +15,26 @@
 #include "../config/ConfigDataValues.hpp"
 #include "widgets/IWidget.hpp"
 #include "Framebuffer.hpp"
+#include "FramebufferPool.hpp"
+#include "GlyphAtlas.hpp"
 
 typedef std::unordered_map<OUTPUTID, std::vector<ASP<IWidget>>> widgetMap_t;
 
 class CRenderer {
   public:
     CRenderer();
+    ~CRenderer();
+
+    enum eShader : uint8_t {
+        SHADER_RECT = 0,
+        SHADER_TEX,
+        SHADER_TEXMIX,
+        SHADER_BLUR1,
+        SHADER_BLUR2,
+        SHADER_BORDER,
+        SHADER_GLYPH,
+        SHADER_COUNT,
+    };
 
     struct SRenderFeedback {
         bool needsFrame = false;
@@ -36,12 +54,34 @@ class CRenderer {
     void            renderTexture(const CBox& box, const CTexture& tex, float a = 1.0, int rounding = 0, std::optional<eTransform> tr = {});
     void renderTextureMix(const CBox& box, const CTexture& tex, const CTexture& tex2, float a = 1.0, float mixFactor = 0.0, int rounding = 0, std::optional<eTransform> tr = {});
     void blurFB(const CFramebuffer& outfb, SBlurParams params);
+    // how far a blur with these parameters visibly spreads a pixel, in pixels
+    static int blurSpread(int size, int passes);
+
+    // times both blur engines at the same visual radius on a 4K target and logs the results
+    void benchmarkBlur();
+
+    // quads are in pixels of the bound framebuffer, top down
+    void                                  renderGlyphs(const CTexture& atlas, const std::vector<CGlyphAtlas::SGlyphQuad>& quads, const CHyprColor& col);
+
+    CGlyphAtlas*                          getGlyphAtlas(const std::string& fontFamily, int fontSize);
 
     UP<CAsyncResourceGatherer>            asyncResourceGatherer;
     std::chrono::system_clock::time_point firstFullFrameTime;
 
-    void                                  pushFb(GLint fb);
+    // scratch targets for blurs, only lease from the ogl thread
+    CFramebufferPool                      fbPool;
+
+    /* only call from ogl thread.
+       Blur results keyed by everything that went into them, so outputs with identical inputs only blur once.
+       An entry lives as long as someone holds on to the framebuffer. */
+    SP<CFramebuffer>                      getSharedBlur(const std::string& key);
+    void                                  addSharedBlur(const std::string& key, const SP<CFramebuffer>& fb);
+
+    // origin is the point of the surface that lands on the bottom left pixel of fb, for drawing parts of it into smaller framebuffers
+    void                                  pushFb(GLint fb, const Vector2D& origin = {});
     void                                  popFb();
+    // box is in surface coordinates like everything drawn into the bound framebuffer, nullptr turns scissoring off
+    void                                  scissor(const CBox* box);
 
     void                                  removeWidgetsFor(OUTPUTID id);
     void                                  reconfigureWidgetsFor(OUTPUTID id);
@@ -58,16 +98,61 @@ class CRenderer {
     CShader            texMixShader;
     CShader            blurShader1;
     CShader            blurShader2;
-    CShader            blurPrepareShader;
-    CShader            blurFinishShader;
     CShader            borderShader;
+    CShader            glyphShader;
+
+    // Programs the config needs are linked on a shared context in the background.
+    // done is set once the thread is through with a shader, linked stays 0 if that failed.
+    struct {
+        std::thread                      thread;
+        std::mutex                       mutex;
+        std::condition_variable          cv;
+        std::array<GLuint, SHADER_COUNT> linked = {};
+        std::array<bool, SHADER_COUNT>   queued = {};
+        std::array<bool, SHADER_COUNT>   done   = {};
+    } shaderCompiler;
+
+    void               startShaderCompiler(const std::vector<eShader>& queue);
+    // only call from ogl thread, before drawing with the shader
+    void               ensureShader(eShader shader);
+    void               setupShader(eShader shader, GLuint prog);
+    CShader&           shaderFor(eShader shader);
+
+    void               blurFBKawase(const CFramebuffer& outfb, const SBlurParams& params);
+    void               blurFBCompute(const CFramebuffer& outfb, const SBlurParams& params);
+    // draws src stretched over all of dst, the caller sets up the shader
+    void               blurPass(CShader& shader, const CTexture& src, const CFramebuffer& dst, float radius);
+    // binds blurShader2 with the final touches (noise, brightness, colorize) for the last pass
+    void               useBlurFinish(const SBlurParams& params);
+    bool               computeBlurSupported();
+
+    // separable gaussian on compute shaders, needs GLES 3.1
+    struct {
+        bool                    checked   = false;
+        bool                    supported = false;
+        CShader                 horizontal;
+        CShader                 vertical;
+        std::array<CTexture, 2> textures; // immutable, so they are recreated when the size changes
+    } computeBlur;
 
     Mat3x3             projMatrix = Mat3x3::identity();
     Mat3x3             projection;
 
     PHLANIMVAR<float>  opacity;
 
-    std::vector<GLint> boundFBs;
+    struct SBoundFB {
+        GLint    fb = 0;
+        Vector2D origin;
+    };
+
+    std::vector<SBoundFB> boundFBs;
+    Vector2D              surfaceSize;
+
+    // keyed by font family and size, shared by all labels
+    std::unordered_map<std::string, UP<CGlyphAtlas>> glyphAtlases;
+
+    // see getSharedBlur
+    std::unordered_map<std::string, WP<CFramebuffer>> sharedBlurs;
 };
 
 inline UP<CRenderer> g_pRenderer;
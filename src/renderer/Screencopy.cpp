@@ -1,6 +1,7 @@
 #include "Screencopy.hpp"
 #include "../helpers/Log.hpp"
 #include "../helpers/MiscFunctions.hpp"
+#include "../helpers/PixelConvert.hpp"
 #include "../core/hyprlock.hpp"
 #include "../core/Egl.hpp"
 #include "../config/ConfigManager.hpp"
@@ -8,9 +9,19 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <cstring>
+#include <algorithm>
 #include <array>
+#include <charconv>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
 #include <cstdint>
 #include <gbm.h>
+#include <xf86drm.h>
 #include <hyprutils/memory/UniquePtr.hpp>
 #include <unistd.h>
 #include <sys/mman.h>
@@ -22,26 +33,263 @@
 static PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES = nullptr;
 static PFNEGLQUERYDMABUFMODIFIERSEXTPROC   eglQueryDmaBufModifiersEXT   = nullptr;
 
+// Recent capture latencies per output, kept across runs to pick the next deadlines.
+// Frames finish on the main thread, the gather thread saves them.
+static constexpr int64_t DEFAULTDEADLINEMS = 2000; // without any history
+static constexpr int64_t MINDEADLINEMS     = 200;
+static constexpr size_t  MAXTIMINGSAMPLES  = 8;
+
+static struct {
+    std::mutex                                            mutex;
+    bool                                                  loaded = false;
+    std::unordered_map<std::string, std::deque<int64_t>> latencies;
+} scTimings;
+
+static std::string timingsFile() {
+    const auto CACHEDIR = getCacheDir();
+    return CACHEDIR.empty() ? "" : CACHEDIR + "/screencopy_timings";
+}
+
+// format: one line per output, the port followed by its latest latencies in ms
+static void loadTimings() {
+    if (scTimings.loaded)
+        return;
+
+    scTimings.loaded = true;
+
+    const auto PATH = timingsFile();
+    if (PATH.empty())
+        return;
+
+    std::ifstream ifs(PATH);
+    std::string   line;
+    while (std::getline(ifs, line)) {
+        std::istringstream iss(line);
+        std::string        port;
+        int64_t            ms = 0;
+        if (!(iss >> port))
+            continue;
+
+        auto& samples = scTimings.latencies[port];
+        while (iss >> ms && samples.size() < MAXTIMINGSAMPLES) {
+            samples.push_back(ms);
+        }
+    }
+}
+
+static void recordLatency(const std::string& port, int64_t ms) {
+    std::lock_guard lg(scTimings.mutex);
+    loadTimings();
+
+    auto& samples = scTimings.latencies[port];
+    samples.push_back(ms);
+    while (samples.size() > MAXTIMINGSAMPLES) {
+        samples.pop_front();
+    }
+}
+
+int64_t CScreencopyFrame::deadlineMsFor(SP<COutput> pOutput) {
+    static const auto SCTIMEOUT = g_pConfigManager->getValue<Hyprlang::INT>("general:screencopy_timeout");
+    if (*SCTIMEOUT > 0)
+        return *SCTIMEOUT;
+
+    std::lock_guard lg(scTimings.mutex);
+    loadTimings();
+
+    const auto IT = scTimings.latencies.find(pOutput->stringPort);
+    if (IT == scTimings.latencies.end() || IT->second.empty())
+        return DEFAULTDEADLINEMS;
+
+    // twice the slowest recent capture. A miss is recorded as the deadline, so the next one doubles.
+    const auto SLOWEST = std::ranges::max(IT->second);
+    return std::clamp<int64_t>(SLOWEST * 2 + 50, MINDEADLINEMS, DEFAULTDEADLINEMS);
+}
+
+template <typename T>
+static void writeStateFile(const std::string& path, const std::unordered_map<std::string, T>& entries, const std::function<void(std::ofstream&, const T&)>& writeEntry) {
+    if (path.empty() || entries.empty())
+        return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path{path}.parent_path(), ec);
+
+    std::ofstream ofs(path, std::ios::trunc);
+    for (const auto& [key, entry] : entries) {
+        ofs << key;
+        writeEntry(ofs, entry);
+        ofs << '\n';
+    }
+
+    if (!ofs.good())
+        Debug::log(WARN, "[sc] Failed to write {}", path);
+}
+
+// Smoothed capture-to-texture latency per output and gpu, for each backend ("shm" or "dma:<modifier>").
+// screencopy_mode = 2 measures both and then sticks with the cheaper one.
+static constexpr int64_t DMAFAILEDMS = 10000; // what a failed dma capture costs
+
+static struct {
+    bool                                                                      loaded = false;
+    std::unordered_map<std::string, std::unordered_map<std::string, int64_t>> costs;
+} scBackends;
+
+// once dma failed, later captures in this run go straight to shm
+static bool dmaFailedThisRun = false;
+
+static std::string backendsFile() {
+    const auto CACHEDIR = getCacheDir();
+    return CACHEDIR.empty() ? "" : CACHEDIR + "/screencopy_backends";
+}
+
+// format: one line per output and gpu, the key followed by backend and cost pairs
+static void loadBackends() {
+    if (scBackends.loaded)
+        return;
+
+    scBackends.loaded = true;
+
+    const auto PATH = backendsFile();
+    if (PATH.empty())
+        return;
+
+    std::ifstream ifs(PATH);
+    std::string   line;
+    while (std::getline(ifs, line)) {
+        std::istringstream iss(line);
+        std::string        key, backend;
+        int64_t            ms = 0;
+        if (!(iss >> key))
+            continue;
+
+        while (iss >> backend >> ms) {
+            scBackends.costs[key][backend] = ms;
+        }
+    }
+}
+
+void CScreencopyFrame::saveTimings() {
+    static const auto SCTIMEOUT = g_pConfigManager->getValue<Hyprlang::INT>("general:screencopy_timeout");
+    static const auto SCMODE    = g_pConfigManager->getValue<Hyprlang::INT>("general:screencopy_mode");
+
+    std::lock_guard   lg(scTimings.mutex);
+
+    if (*SCTIMEOUT <= 0) {
+        writeStateFile<std::deque<int64_t>>(timingsFile(), scTimings.latencies, [](std::ofstream& ofs, const std::deque<int64_t>& samples) {
+            for (const auto ms : samples) {
+                ofs << ' ' << ms;
+            }
+        });
+    }
+
+    if (*SCMODE == 2) {
+        writeStateFile<std::unordered_map<std::string, int64_t>>(backendsFile(), scBackends.costs, [](std::ofstream& ofs, const std::unordered_map<std::string, int64_t>& costs) {
+            for (const auto& [backend, ms] : costs) {
+                ofs << ' ' << backend << ' ' << ms;
+            }
+        });
+    }
+}
+
+static std::string backendKey(const SP<COutput>& pOutput) {
+    std::string gpu = "nogpu";
+    if (g_pHyprlock->dma.gbmDevice) {
+        if (const auto NAME = drmGetDeviceNameFromFd2(gbm_device_get_fd(g_pHyprlock->dma.gbmDevice)); NAME) {
+            gpu = std::filesystem::path{NAME}.filename();
+            free(NAME);
+        }
+    }
+
+    return pOutput->stringPort + "@" + gpu;
+}
+
+static void recordBackendCost(const std::string& key, const std::string& backend, int64_t ms) {
+    std::lock_guard lg(scTimings.mutex);
+    loadBackends();
+
+    auto& costs = scBackends.costs[key];
+    if (const auto IT = costs.find(backend); IT != costs.end())
+        ms = (IT->second * 3 + ms) / 4;
+
+    costs[backend] = ms;
+}
+
+// "shm", "dma" or "dma:<modifier>". Tries each of shm and dma once before comparing them.
+static std::string pickBackend(const std::string& key) {
+    std::lock_guard lg(scTimings.mutex);
+    loadBackends();
+
+    const auto IT = scBackends.costs.find(key);
+    if (IT == scBackends.costs.end() || std::ranges::none_of(IT->second, [](const auto& c) { return c.first.starts_with("dma"); }))
+        return "dma";
+
+    if (!IT->second.contains("shm"))
+        return "shm";
+
+    return std::ranges::min_element(IT->second, {}, [](const auto& c) { return c.second; })->first;
+}
+
 //
-std::string CScreencopyFrame::getResourceId(SP<COutput> pOutput) {
-    return RESOURCEIDPREFIX + std::format(":{}-{}x{}", pOutput->stringPort, pOutput->size.x, pOutput->size.y);
+ResourceID CScreencopyFrame::getResourceId(SP<COutput> pOutput) {
+    return std::hash<std::string>{}(std::format("screencopy:{}-{}x{}", pOutput->stringPort, pOutput->size.x, pOutput->size.y));
 }
 
-CScreencopyFrame::CScreencopyFrame(SP<COutput> pOutput) : m_outputRef(pOutput) {
+CScreencopyFrame::CScreencopyFrame(SP<COutput> pOutput, std::function<void()> onDone) : m_outputRef(pOutput), m_onDone(std::move(onDone)) {
+    m_captureStart = std::chrono::steady_clock::now();
+
+    const auto DEADLINEMS = deadlineMsFor(pOutput);
+    m_deadline            = m_captureStart + std::chrono::milliseconds(DEADLINEMS);
+
+    // 0 = dma, 1 = shm, 2 = whichever was faster before
+    static const auto SCMODE  = g_pConfigManager->getValue<Hyprlang::INT>("general:screencopy_mode");
+    std::string       backend = *SCMODE == 1 ? "shm" : "dma";
+    if (*SCMODE == 2) {
+        m_backendKey = backendKey(pOutput);
+        backend      = pickBackend(m_backendKey);
+    }
+
+    if (dmaFailedThisRun)
+        backend = "shm";
+
+    Debug::log(LOG, "[sc] Capturing {} via {} with a deadline of {}ms", pOutput->stringPort, backend, DEADLINEMS);
+
     captureOutput();
 
-    static const auto SCMODE = g_pConfigManager->getValue<Hyprlang::INT>("general:screencopy_mode");
-    if (*SCMODE == 1)
+    uint64_t mod = 0;
+    if (backend == "shm")
         m_frame = makeUnique<CSCSHMFrame>(m_sc);
+    else if (backend.starts_with("dma:") && std::from_chars(backend.data() + 4, backend.data() + backend.size(), mod, 16).ec == std::errc{})
+        m_frame = makeUnique<CSCDMAFrame>(m_sc, mod);
     else
         m_frame = makeUnique<CSCDMAFrame>(m_sc);
 }
 
+bool CScreencopyFrame::fallBackToSHM() {
+    if (m_dmaFailed || !m_frame || !m_frame->backendName().starts_with("dma"))
+        return false;
+
+    Debug::log(WARN, "[sc] DMA screencopy failed, retrying with SHM");
+
+    m_dmaFailed      = true;
+    dmaFailedThisRun = true;
+
+    if (!m_backendKey.empty())
+        recordBackendCost(m_backendKey, m_frame->backendName(), DMAFAILEDMS);
+
+    // we might be inside one of its callbacks, keep it around
+    m_failedSc = std::move(m_sc);
+    m_frame.reset();
+
+    captureOutput();
+    m_frame = makeUnique<CSCSHMFrame>(m_sc);
+    return true;
+}
+
 void CScreencopyFrame::captureOutput() {
     const auto POUTPUT = m_outputRef.lock();
     RASSERT(POUTPUT, "Screencopy, but no valid output");
 
-    m_resourceID = getResourceId(POUTPUT);
+    m_resourceID   = getResourceId(POUTPUT);
+    m_attemptStart = std::chrono::steady_clock::now();
 
     m_sc = makeShared<CCZwlrScreencopyFrameV1>(g_pHyprlock->getScreencopy()->sendCaptureOutput(false, POUTPUT->m_wlOutput->resource()));
 
@@ -50,6 +298,8 @@ void CScreencopyFrame::captureOutput() {
 
         if (!m_frame || !m_frame->onBufferDone() || !m_frame->m_wlBuffer) {
             Debug::log(ERR, "[sc] Failed to create a wayland buffer for the screencopy frame");
+            if (!fallBackToSHM())
+                onDone(false);
             return;
         }
 
@@ -61,7 +311,11 @@ void CScreencopyFrame::captureOutput() {
     m_sc->setFailed([this](CCZwlrScreencopyFrameV1* r) {
         Debug::log(ERR, "[sc] wlrOnFailed for {}", (void*)r);
 
+        if (fallBackToSHM())
+            return;
+
         m_frame.reset();
+        onDone(false);
     });
 
     m_sc->setReady([this](CCZwlrScreencopyFrameV1* r, uint32_t, uint32_t, uint32_t) {
@@ -69,14 +323,59 @@ void CScreencopyFrame::captureOutput() {
 
         if (!m_frame || !m_frame->onBufferReady(m_asset)) {
             Debug::log(ERR, "[sc] Failed to bind the screencopy buffer to a texture");
+            if (!fallBackToSHM())
+                onDone(false);
             return;
         }
 
+        if (!m_backendKey.empty())
+            recordBackendCost(m_backendKey, m_frame->backendName(),
+                              std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_attemptStart).count());
+
         m_sc.reset();
+        onDone(true);
     });
 }
 
-CSCDMAFrame::CSCDMAFrame(SP<CCZwlrScreencopyFrameV1> sc) : m_sc(sc) {
+void CScreencopyFrame::onDone(bool success) {
+    if (m_done)
+        return;
+
+    m_done      = true;
+    m_latencyMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_captureStart).count();
+
+    const auto POUTPUT = m_outputRef.lock();
+    Debug::log(LOG, "[sc] {} for output {} after {}ms", success ? "Captured" : "Failed capture", POUTPUT ? POUTPUT->stringPort : "?", m_latencyMs);
+
+    if (success && POUTPUT)
+        recordLatency(POUTPUT->stringPort, m_latencyMs);
+
+    if (m_onDone)
+        m_onDone();
+}
+
+bool CScreencopyFrame::expire(std::chrono::steady_clock::time_point now) {
+    if (m_done)
+        return true;
+
+    if (now < m_deadline)
+        return false;
+
+    const auto POUTPUT = m_outputRef.lock();
+    Debug::log(WARN, "[sc] Output {} missed its screencopy deadline, it will use background:color", POUTPUT ? POUTPUT->stringPort : "?");
+
+    // drop the request, whatever arrives later would be hyprlock itself
+    m_sc.reset();
+    m_frame.reset();
+
+    if (POUTPUT)
+        recordLatency(POUTPUT->stringPort, std::chrono::duration_cast<std::chrono::milliseconds>(m_deadline - m_captureStart).count());
+
+    onDone(false);
+    return true;
+}
+
+CSCDMAFrame::CSCDMAFrame(SP<CCZwlrScreencopyFrameV1> sc, std::optional<uint64_t> preferredMod) : m_sc(sc), m_preferredMod(preferredMod) {
     if (!glEGLImageTargetTexture2DOES) {
         glEGLImageTargetTexture2DOES = (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress("glEGLImageTargetTexture2DOES");
         if (!glEGLImageTargetTexture2DOES) {
@@ -147,6 +446,12 @@ bool CSCDMAFrame::onBufferDone() {
                 goodMods.emplace_back(mods[i]);
             }
 
+            // the one that was fastest before, if it is still around
+            if (m_preferredMod && std::ranges::find(goodMods, *m_preferredMod) != goodMods.end()) {
+                Debug::log(LOG, "[bo] Preferring modifier {:x}", *m_preferredMod);
+                goodMods = {*m_preferredMod};
+            }
+
             m_bo = gbm_bo_create_with_modifiers2(g_pHyprlock->dma.gbmDevice, m_w, m_h, m_fmt, goodMods.data(), goodMods.size(), flags);
         }
     }
@@ -273,48 +578,105 @@ bool CSCDMAFrame::onBufferReady(SPreloadedAsset& asset) {
     return true;
 }
 
-CSCSHMFrame::CSCSHMFrame(SP<CCZwlrScreencopyFrameV1> sc) : m_sc(sc) {
-    Debug::log(TRACE, "[sc] [shm] Creating a SHM frame");
+CSCSHMPool::CSCSHMPool(uint32_t format, uint32_t stride, uint32_t height, size_t slots) :
+    m_format(format), m_stride(stride), m_height(height), m_slotSize((size_t)stride * height), m_used(slots, false) {
+    m_size = m_slotSize * slots;
 
-    m_sc->setBuffer([this](CCZwlrScreencopyFrameV1* r, uint32_t format, uint32_t width, uint32_t height, uint32_t stride) {
-        Debug::log(TRACE, "[sc] [shm] wlrOnBuffer for {}", (void*)this);
+    const auto FD = createPoolFile(m_size);
+    if (FD < 0) {
+        Debug::log(ERR, "[sc] [shm] failed to create a pool file");
+        return;
+    }
 
-        const auto SIZE = stride * height;
-        m_shmFmt        = format;
-        m_w             = width;
-        m_h             = height;
-        m_stride        = stride;
+    m_data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, FD, 0);
+    if (m_data == MAP_FAILED) {
+        Debug::log(ERR, "[sc] [shm] failed to mmap the pool (errno {})", strerror(errno));
+        m_data = nullptr;
+        close(FD);
+        return;
+    }
 
-        // Create a shm pool with format and size
-        std::string shmPoolFile;
-        const auto  FD = createPoolFile(SIZE, shmPoolFile);
+    if (!g_pHyprlock->getShm()) {
+        Debug::log(ERR, "[sc] [shm] Failed to get WLShm global");
+        close(FD);
+        return;
+    }
 
-        if (FD < 0) {
-            Debug::log(ERR, "[sc] [shm] failed to create a pool file");
-            return;
-        }
+    m_pool = makeShared<CCWlShmPool>(g_pHyprlock->getShm()->sendCreatePool(FD, m_size));
 
-        m_shmData = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, FD, 0);
-        if (m_shmData == MAP_FAILED) {
-            Debug::log(ERR, "[sc] [shm] failed to (errno {})", strerror(errno));
-            close(FD);
-            m_ok = false;
-            return;
+    // the compositor has its own reference now
+    close(FD);
+
+    Debug::log(LOG, "[sc] [shm] Created a pool with {} slot(s) of {} bytes", slots, m_slotSize);
+}
+
+CSCSHMPool::~CSCSHMPool() {
+    m_pool.reset();
+    if (m_data)
+        munmap(m_data, m_size);
+}
+
+SP<CSCSHMPool> CSCSHMPool::acquire(uint32_t format, uint32_t stride, uint32_t height, size_t& slot) {
+    std::erase_if(s_pools, [](const auto& pool) { return pool.expired(); });
+
+    for (const auto& WEAK : s_pools) {
+        const auto POOL = WEAK.lock();
+        if (POOL->m_format != format || POOL->m_stride != stride || POOL->m_height != height)
+            continue;
+
+        for (size_t i = 0; i < POOL->m_used.size(); ++i) {
+            if (POOL->m_used[i])
+                continue;
+
+            POOL->m_used[i] = true;
+            slot            = i;
+            return POOL;
         }
+    }
+
+    // enough room for every output to be the same, untouched slots cost no memory
+    auto pool = makeShared<CSCSHMPool>(format, stride, height, std::max<size_t>(g_pHyprlock->m_vOutputs.size(), 1));
+    if (!pool->m_pool)
+        return nullptr;
 
-        if (!g_pHyprlock->getShm()) {
-            Debug::log(ERR, "[sc] [shm] Failed to get WLShm global");
-            close(FD);
+    s_pools.emplace_back(pool);
+
+    pool->m_used[0] = true;
+    slot            = 0;
+    return pool;
+}
+
+void CSCSHMPool::release(size_t slot) {
+    m_used[slot] = false;
+}
+
+size_t CSCSHMPool::slotOffset(size_t slot) const {
+    return slot * m_slotSize;
+}
+
+void* CSCSHMPool::slotData(size_t slot) const {
+    return (uint8_t*)m_data + slotOffset(slot);
+}
+
+CSCSHMFrame::CSCSHMFrame(SP<CCZwlrScreencopyFrameV1> sc) : m_sc(sc) {
+    Debug::log(TRACE, "[sc] [shm] Creating a SHM frame");
+
+    m_sc->setBuffer([this](CCZwlrScreencopyFrameV1* r, uint32_t format, uint32_t width, uint32_t height, uint32_t stride) {
+        Debug::log(TRACE, "[sc] [shm] wlrOnBuffer for {}", (void*)this);
+
+        m_shmFmt = format;
+        m_w      = width;
+        m_h      = height;
+        m_stride = stride;
+
+        m_pool = CSCSHMPool::acquire(format, stride, height, m_slot);
+        if (!m_pool) {
             m_ok = false;
             return;
         }
 
-        auto pShmPool = makeShared<CCWlShmPool>(g_pHyprlock->getShm()->sendCreatePool(FD, SIZE));
-        m_wlBuffer    = makeShared<CCWlBuffer>(pShmPool->sendCreateBuffer(0, width, height, stride, m_shmFmt));
-
-        pShmPool.reset();
-
-        close(FD);
+        m_shmData  = m_pool->slotData(m_slot);
+        m_wlBuffer = makeShared<CCWlBuffer>(m_pool->m_pool->sendCreateBuffer(m_pool->slotOffset(m_slot), width, height, stride, m_shmFmt));
     });
 
     m_sc->setLinuxDmabuf([](CCZwlrScreencopyFrameV1* r, uint32_t, uint32_t, uint32_t) {
@@ -325,77 +687,35 @@ CSCSHMFrame::CSCSHMFrame(SP<CCZwlrScreencopyFrameV1> sc) : m_sc(sc) {
 CSCSHMFrame::~CSCSHMFrame() {
     if (m_convBuffer)
         free(m_convBuffer);
-    if (m_shmData)
-        munmap(m_shmData, m_stride * m_h);
+
+    m_wlBuffer.reset();
+    if (m_pool)
+        m_pool->release(m_slot);
 }
 
 void CSCSHMFrame::convertBuffer() {
     const auto BYTESPERPX = m_stride / m_w;
     if (BYTESPERPX == 4) {
+        uint8_t* data = (uint8_t*)m_shmData;
+
         switch (m_shmFmt) {
             case WL_SHM_FORMAT_ARGB8888:
             case WL_SHM_FORMAT_XRGB8888: {
                 Debug::log(LOG, "[sc] [shm] Converting ARGB to RGBA");
-                uint8_t* data = (uint8_t*)m_shmData;
-
-                for (uint32_t y = 0; y < m_h; ++y) {
-                    for (uint32_t x = 0; x < m_w; ++x) {
-                        struct pixel {
-                            // little-endian ARGB
-                            unsigned char blue;
-                            unsigned char green;
-                            unsigned char red;
-                            unsigned char alpha;
-                        }* px = (struct pixel*)(data + (y * m_w * 4) + (x * 4));
-
-                        // RGBA
-                        *px = {.blue = px->red, .green = px->green, .red = px->blue, .alpha = px->alpha};
-                    }
-                }
+                PixelConvert::forRowBands(m_h, [&](uint32_t first, uint32_t end) { PixelConvert::swapRB(data + (size_t)first * m_w * 4, (size_t)(end - first) * m_w); });
             } break;
             case WL_SHM_FORMAT_ABGR8888:
             case WL_SHM_FORMAT_XBGR8888: {
-                Debug::log(LOG, "[sc] [shm] Converting ABGR to RGBA");
-                uint8_t* data = (uint8_t*)m_shmData;
-
-                for (uint32_t y = 0; y < m_h; ++y) {
-                    for (uint32_t x = 0; x < m_w; ++x) {
-                        struct pixel {
-                            // little-endian ARGB
-                            unsigned char blue;
-                            unsigned char green;
-                            unsigned char red;
-                            unsigned char alpha;
-                        }* px = (struct pixel*)(data + (y * m_w * 4) + (x * 4));
-
-                        // BGRA
-                        *px = {.blue = px->blue, .green = px->green, .red = px->red, .alpha = px->alpha};
-                    }
-                }
+                // little-endian ABGR is RGBA in memory already
+                Debug::log(LOG, "[sc] [shm] ABGR needs no conversion");
             } break;
             case WL_SHM_FORMAT_ABGR2101010:
             case WL_SHM_FORMAT_ARGB2101010:
             case WL_SHM_FORMAT_XRGB2101010:
             case WL_SHM_FORMAT_XBGR2101010: {
                 Debug::log(LOG, "[sc] [shm] Converting 10-bit channels to 8-bit");
-                uint8_t*   data = (uint8_t*)m_shmData;
-
                 const bool FLIP = m_shmFmt != WL_SHM_FORMAT_XBGR2101010;
-
-                for (uint32_t y = 0; y < m_h; ++y) {
-                    for (uint32_t x = 0; x < m_w; ++x) {
-                        uint32_t* px = (uint32_t*)(data + (y * m_w * 4) + (x * 4));
-
-                        // conv to 8 bit
-                        uint8_t R = (uint8_t)std::round((255.0 * (((*px) & 0b00000000000000000000001111111111) >> 0) / 1023.0));
-                        uint8_t G = (uint8_t)std::round((255.0 * (((*px) & 0b00000000000011111111110000000000) >> 10) / 1023.0));
-                        uint8_t B = (uint8_t)std::round((255.0 * (((*px) & 0b00111111111100000000000000000000) >> 20) / 1023.0));
-                        uint8_t A = (uint8_t)std::round((255.0 * (((*px) & 0b11000000000000000000000000000000) >> 30) / 3.0));
-
-                        // write 8-bit values
-                        *px = ((FLIP ? B : R) << 0) + (G << 8) + ((FLIP ? R : B) << 16) + (A << 24);
-                    }
-                }
+                PixelConvert::forRowBands(m_h, [&](uint32_t first, uint32_t end) { PixelConvert::convert2101010(data + (size_t)first * m_w * 4, (size_t)(end - first) * m_w, FLIP); });
             } break;
             default: {
                 Debug::log(WARN, "[sc] [shm] Unsupported format {}", m_shmFmt);
@@ -408,47 +728,15 @@ void CSCSHMFrame::convertBuffer() {
         RASSERT(m_convBuffer, "malloc failed");
 
         switch (m_shmFmt) {
-            case WL_SHM_FORMAT_BGR888: {
-                Debug::log(LOG, "[sc] [shm] Converting BGR to RGBA");
-                for (uint32_t y = 0; y < m_h; ++y) {
-                    for (uint32_t x = 0; x < m_w; ++x) {
-                        struct pixel3 {
-                            // little-endian RGB
-                            unsigned char blue;
-                            unsigned char green;
-                            unsigned char red;
-                        }* srcPx = (struct pixel3*)((char*)m_shmData + (y * m_stride) + (x * 3));
-                        struct pixel4 {
-                            // little-endian ARGB
-                            unsigned char blue;
-                            unsigned char green;
-                            unsigned char red;
-                            unsigned char alpha;
-                        }* dstPx = (struct pixel4*)((char*)m_convBuffer + (y * NEWSTRIDE) + (x * 4));
-                        *dstPx   = {.blue = srcPx->blue, .green = srcPx->green, .red = srcPx->red, .alpha = 0xFF};
-                    }
-                }
-            } break;
+            // Both end up as the source bytes followed by 0xFF
+            case WL_SHM_FORMAT_BGR888:
             case WL_SHM_FORMAT_RGB888: {
-                Debug::log(LOG, "[sc] [shm] Converting RGB to RGBA");
-                for (uint32_t y = 0; y < m_h; ++y) {
-                    for (uint32_t x = 0; x < m_w; ++x) {
-                        struct pixel3 {
-                            // big-endian RGB
-                            unsigned char red;
-                            unsigned char green;
-                            unsigned char blue;
-                        }* srcPx = (struct pixel3*)((char*)m_shmData + (y * m_stride) + (x * 3));
-                        struct pixel4 {
-                            // big-endian ARGB
-                            unsigned char alpha;
-                            unsigned char red;
-                            unsigned char green;
-                            unsigned char blue;
-                        }* dstPx = (struct pixel4*)((char*)m_convBuffer + (y * NEWSTRIDE) + (x * 4));
-                        *dstPx   = {.alpha = srcPx->red, .red = srcPx->green, .green = srcPx->blue, .blue = 0xFF};
+                Debug::log(LOG, "[sc] [shm] Converting {} to RGBA", m_shmFmt == WL_SHM_FORMAT_BGR888 ? "BGR" : "RGB");
+                PixelConvert::forRowBands(m_h, [&](uint32_t first, uint32_t end) {
+                    for (uint32_t y = first; y < end; ++y) {
+                        PixelConvert::expand24((const uint8_t*)m_shmData + (size_t)y * m_stride, (uint8_t*)m_convBuffer + (size_t)y * NEWSTRIDE, m_w);
                     }
-                }
+                });
             } break;
             default: {
                 Debug::log(ERR, "[sc] [shm] Unsupported format for 24bit buffer {}", m_shmFmt);
@@ -461,7 +749,48 @@ void CSCSHMFrame::convertBuffer() {
 }
 
 bool CSCSHMFrame::onBufferReady(SPreloadedAsset& asset) {
-    convertBuffer();
+    // Upload the mmap'd buffer as is and let GL deal with the layout.
+    // Channel order is fixed with swizzles, 10 bit channels are unpacked by the gpu.
+    GLint    glIFormat     = GL_RGBA8;
+    GLint    glFormat      = GL_RGBA;
+    GLint    glType        = GL_UNSIGNED_BYTE;
+    uint32_t bytesPerPixel = 4;
+    bool     swapRB        = false;
+    bool     opaque        = false;
+    bool     direct        = true;
+
+    switch (m_shmFmt) {
+        case WL_SHM_FORMAT_ARGB8888:
+        case WL_SHM_FORMAT_XRGB8888: swapRB = true; break;
+        case WL_SHM_FORMAT_ABGR8888:
+        case WL_SHM_FORMAT_XBGR8888: break;
+        case WL_SHM_FORMAT_ABGR2101010:
+        case WL_SHM_FORMAT_ARGB2101010:
+        case WL_SHM_FORMAT_XRGB2101010:
+        case WL_SHM_FORMAT_XBGR2101010:
+            swapRB = m_shmFmt != WL_SHM_FORMAT_XBGR2101010;
+            // only the X formats have padding in the 2 alpha bits, the A formats keep theirs
+            opaque    = m_shmFmt == WL_SHM_FORMAT_XRGB2101010 || m_shmFmt == WL_SHM_FORMAT_XBGR2101010;
+            glIFormat = GL_RGB10_A2;
+            glType    = GL_UNSIGNED_INT_2_10_10_10_REV;
+            break;
+        case WL_SHM_FORMAT_BGR888:
+        case WL_SHM_FORMAT_RGB888:
+            glIFormat     = GL_RGB8;
+            glFormat      = GL_RGB;
+            bytesPerPixel = 3;
+            break;
+        default: direct = false;
+    }
+
+    // GL can only skip row padding in whole pixels
+    if (m_stride % bytesPerPixel != 0 || m_stride < m_w * bytesPerPixel)
+        direct = false;
+
+    if (!direct) {
+        Debug::log(LOG, "[sc] [shm] Can't upload format {} with stride {} directly, converting", m_shmFmt, m_stride);
+        convertBuffer();
+    }
 
     asset.texture.allocate();
     asset.texture.m_vSize.x = m_w;
@@ -469,13 +798,28 @@ bool CSCSHMFrame::onBufferReady(SPreloadedAsset& asset) {
 
     glBindTexture(GL_TEXTURE_2D, asset.texture.m_iTexID);
 
-    void* buffer = m_convBuffer ? m_convBuffer : m_shmData;
-
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_w, m_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+
+    if (direct) {
+        if (swapRB) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        }
+
+        if (opaque)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, m_stride / bytesPerPixel);
+        glTexImage2D(GL_TEXTURE_2D, 0, glIFormat, m_w, m_h, 0, glFormat, glType, m_shmData);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    } else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_w, m_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_convBuffer ? m_convBuffer : m_shmData);
+
     glBindTexture(GL_TEXTURE_2D, 0);
 
     Debug::log(LOG, "[sc] [shm] Got screenshot with size {}", asset.texture.m_vSize);
@@ -2,9 +2,14 @@
 
 #include "../defines.hpp"
 #include "../core/Output.hpp"
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <gbm.h>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 #include "Shared.hpp"
 #include "linux-dmabuf-v1.hpp"
 #include "wlr-screencopy-unstable-v1.hpp"
@@ -17,45 +22,74 @@ class ISCFrame {
     virtual bool   onBufferDone()                        = 0;
     virtual bool   onBufferReady(SPreloadedAsset& asset) = 0;
 
-    SP<CCWlBuffer> m_wlBuffer = nullptr;
+    // "shm" or "dma:<modifier>", for comparing capture costs
+    virtual std::string backendName() = 0;
+
+    SP<CCWlBuffer>      m_wlBuffer = nullptr;
 };
 
 class CScreencopyFrame {
   public:
-    static std::string                 getResourceId(SP<COutput> pOutput);
-    static constexpr const std::string RESOURCEIDPREFIX = "screencopy";
+    static ResourceID getResourceId(SP<COutput> pOutput);
 
-    CScreencopyFrame(SP<COutput> pOutput);
+    // onDone fires exactly once, when the frame is either ready or failed
+    CScreencopyFrame(SP<COutput> pOutput, std::function<void()> onDone);
     ~CScreencopyFrame() = default;
 
-    void                        captureOutput();
+    void                                  captureOutput();
 
-    SP<CCZwlrScreencopyFrameV1> m_sc = nullptr;
+    SP<CCZwlrScreencopyFrameV1>           m_sc = nullptr;
+
+    ResourceID                            m_resourceID = 0;
+    SPreloadedAsset                       m_asset;
 
-    std::string                 m_resourceID;
-    SPreloadedAsset             m_asset;
+    bool                                  m_done      = false;
+    int64_t                               m_latencyMs = -1; // from the capture request to ready/failed
+    std::chrono::steady_clock::time_point m_deadline;       // counts as failed after this
+
+    // fails the capture once its deadline has passed, returns false if the frame is still pending
+    bool expire(std::chrono::steady_clock::time_point now);
+
+    // per output, from screencopy_timeout or the timings of earlier captures
+    static int64_t deadlineMsFor(SP<COutput> pOutput);
+    // persists the timings and backend costs recorded so far, call once all frames are done
+    static void saveTimings();
 
   private:
-    WP<COutput>  m_outputRef;
-    UP<ISCFrame> m_frame = nullptr;
+    void                                  onDone(bool success);
+    // retries a failed dma capture once with shm, returns false if there is nothing to retry
+    bool                                  fallBackToSHM();
+
+    WP<COutput>                           m_outputRef;
+    UP<ISCFrame>                          m_frame    = nullptr;
+    SP<CCZwlrScreencopyFrameV1>           m_failedSc = nullptr;
 
-    bool         m_dmaFailed = false;
+    std::function<void()>                 m_onDone;
+    std::chrono::steady_clock::time_point m_captureStart;
+    std::chrono::steady_clock::time_point m_attemptStart; // of the current backend
+
+    std::string                           m_backendKey; // output and gpu, empty unless screencopy_mode = 2
+    bool                                  m_dmaFailed = false;
 };
 
 // Uses a gpu buffer created via gbm_bo
 class CSCDMAFrame : public ISCFrame {
   public:
-    CSCDMAFrame(SP<CCZwlrScreencopyFrameV1> sc);
+    CSCDMAFrame(SP<CCZwlrScreencopyFrameV1> sc, std::optional<uint64_t> preferredMod = std::nullopt);
     virtual ~CSCDMAFrame();
 
-    virtual bool onBufferReady(SPreloadedAsset& asset);
-    virtual bool onBufferDone();
+    virtual bool        onBufferReady(SPreloadedAsset& asset);
+    virtual bool        onBufferDone();
+    virtual std::string backendName() {
+        return std::format("dma:{:x}", m_mod);
+    }
 
   private:
     gbm_bo*                     m_bo = nullptr;
 
     int                         m_planes = 0;
     uint64_t                    m_mod    = 0;
+    std::optional<uint64_t>     m_preferredMod;
 
     int                         m_fd[4];
     uint32_t                    m_stride[4], m_offset[4];
@@ -68,6 +102,37 @@ class CSCDMAFrame : public ISCFrame {
     EGLImage                    m_image = nullptr;
 };
 
+// One wl_shm_pool split into equal slots. Outputs with the same format and buffer layout
+// share a pool, so capturing them all takes one allocation and one mapping.
+class CSCSHMPool {
+  public:
+    CSCSHMPool(uint32_t format, uint32_t stride, uint32_t height, size_t slots);
+    ~CSCSHMPool();
+
+    CSCSHMPool(const CSCSHMPool&)            = delete;
+    CSCSHMPool& operator=(const CSCSHMPool&) = delete;
+
+    // finds a pool with a free slot for this layout or creates one, returns nullptr on failure
+    static SP<CSCSHMPool> acquire(uint32_t format, uint32_t stride, uint32_t height, size_t& slot);
+    void                  release(size_t slot);
+
+    size_t                slotOffset(size_t slot) const;
+    void*                 slotData(size_t slot) const;
+
+    SP<CCWlShmPool>       m_pool = nullptr;
+
+  private:
+    uint32_t                                  m_format = 0, m_stride = 0, m_height = 0;
+
+    size_t                                    m_slotSize = 0;
+    std::vector<bool>                         m_used;
+
+    void*                                     m_data = nullptr;
+    size_t                                    m_size = 0;
+
+    inline static std::vector<WP<CSCSHMPool>> s_pools;
+};
+
 // Uses a shm buffer - is slow and needs ugly format conversion
 // Used as a fallback just in case.
 class CSCSHMFrame : public ISCFrame {
@@ -78,8 +143,11 @@ class CSCSHMFrame : public ISCFrame {
     virtual bool onBufferDone() {
         return m_ok;
     }
-    virtual bool onBufferReady(SPreloadedAsset& asset);
-    void         convertBuffer();
+    virtual bool        onBufferReady(SPreloadedAsset& asset);
+    virtual std::string backendName() {
+        return "shm";
+    }
+    void convertBuffer();
 
   private:
     bool                        m_ok = true;
@@ -92,4 +160,7 @@ class CSCSHMFrame : public ISCFrame {
     uint32_t                    m_shmFmt     = 0;
     void*                       m_shmData    = nullptr;
     void*                       m_convBuffer = nullptr;
+
+    SP<CSCSHMPool>              m_pool = nullptr;
+    size_t                      m_slot = 0;
 };
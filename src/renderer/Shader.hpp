@@ -53,7 +53,8 @@ class CShader {
     GLint   distort   = -1;
     GLint   wl_output = -1;
 
-    // Blur prepare
+    // Blur prepare, part of the first down pass
+    GLint prepare  = -1;
     GLint contrast = -1;
 
     // Blur
@@ -61,7 +62,8 @@ class CShader {
     GLint vibrancy          = -1;
     GLint vibrancy_darkness = -1;
 
-    // Blur finish
+    // Blur finish, part of the last up pass
+    GLint finish     = -1;
     GLint brightness = -1;
     GLint noise      = -1;
 
@@ -70,6 +72,10 @@ class CShader {
     GLint colorizeTint = -1;
     GLint boostA       = -1;
 
+    // glyphs
+    GLint glyphBoxAttrib = -1;
+    GLint glyphUVAttrib  = -1;
+
     GLint getUniformLocation(const std::string&);
 
     void  destroy();
@@ -184,6 +184,11 @@ uniform int          passes;
 uniform float        vibrancy;
 uniform float        vibrancy_darkness;
 
+// first pass only, reads the unblurred image
+uniform int          prepare;
+uniform float        contrast;
+uniform float        brightness;
+
 // see http://alienryderflex.com/hsp.html
 const float Pr = 0.299;
 const float Pg = 0.587;
@@ -282,14 +287,40 @@ vec3 hsl2rgb(vec3 col) {
     return rgb;
 }
 
+float gain(float x, float k) {
+    float a = 0.5 * pow(2.0 * ((x < 0.5) ? x : 1.0 - x), k);
+    return (x < 0.5) ? a : 1.0 - a;
+}
+
+vec4 sampleTex(vec2 uv) {
+    vec4 pixColor = texture2D(tex, uv);
+    if (prepare == 0)
+        return pixColor;
+
+    // contrast
+    if (contrast != 1.0) {
+        pixColor.r = gain(pixColor.r, contrast);
+        pixColor.g = gain(pixColor.g, contrast);
+        pixColor.b = gain(pixColor.b, contrast);
+    }
+
+    // brightness
+    if (brightness > 1.0) {
+        pixColor.rgb *= brightness;
+    }
+
+    return pixColor;
+}
+
 void main() {
-    vec2 uv = v_texcoord * 2.0;
+    // renders into a level half the size of tex
+    vec2 uv = v_texcoord;
 
-    vec4 sum = texture2D(tex, uv) * 4.0;
-    sum += texture2D(tex, uv - halfpixel.xy * radius);
-    sum += texture2D(tex, uv + halfpixel.xy * radius);
-    sum += texture2D(tex, uv + vec2(halfpixel.x, -halfpixel.y) * radius);
-    sum += texture2D(tex, uv - vec2(halfpixel.x, -halfpixel.y) * radius);
+    vec4 sum = sampleTex(uv) * 4.0;
+    sum += sampleTex(uv - halfpixel.xy * radius);
+    sum += sampleTex(uv + halfpixel.xy * radius);
+    sum += sampleTex(uv + vec2(halfpixel.x, -halfpixel.y) * radius);
+    sum += sampleTex(uv - vec2(halfpixel.x, -halfpixel.y) * radius);
 
     vec4 color = sum / 8.0;
 
@@ -325,8 +356,21 @@ uniform sampler2D tex;
 uniform float radius;
 uniform vec2 halfpixel;
 
+// last pass only, writes the final image
+uniform int finish;
+uniform float noise;
+uniform float brightness;
+uniform int colorize;
+uniform vec3 colorizeTint;
+uniform float boostA;
+
+float hash(vec2 p) {
+    return fract(sin(dot(p, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
 void main() {
-    vec2 uv = v_texcoord / 2.0;
+    // renders into a level twice the size of tex
+    vec2 uv = v_texcoord;
 
     vec4 sum = texture2D(tex, uv + vec2(-halfpixel.x * 2.0, 0.0) * radius);
 
@@ -338,25 +382,66 @@ void main() {
     sum += texture2D(tex, uv + vec2(0.0, -halfpixel.y * 2.0) * radius);
     sum += texture2D(tex, uv + vec2(-halfpixel.x, -halfpixel.y) * radius) * 2.0;
 
-    gl_FragColor = sum / 12.0;
+    vec4 pixColor = sum / 12.0;
+    if (finish == 0) {
+        gl_FragColor = pixColor;
+        return;
+    }
+
+    // noise
+    float noiseHash   = hash(v_texcoord);
+    float noiseAmount = (mod(noiseHash, 1.0) - 0.5);
+    pixColor.rgb += noiseAmount * noise;
+
+    // brightness
+    if (brightness < 1.0) {
+        pixColor.rgb *= brightness;
+    }
+
+    pixColor.a *= boostA;
+
+    if (colorize == 1) {
+        gl_FragColor = vec4(colorizeTint.r * pixColor.a, colorizeTint.g * pixColor.a, colorizeTint.b * pixColor.a, pixColor.a);
+        return;
+    }
+
+    gl_FragColor = pixColor;
 }
 )#";
 
-inline const std::string FRAGBLURPREPARE = R"#(
-precision         highp float;
-varying vec2      v_texcoord; // is in 0-1
-uniform sampler2D tex;
+// Separable gaussian, one row (or column) of TILE pixels per work group.
+// Needs "#version 310 es" and "#define DIRECTION 0" (horizontal) or 1 (vertical) in front.
+inline const std::string COMPUTEBLUR = R"#(
+precision highp float;
+precision highp image2D;
+
+#define TILE 256
+#define MAXRADIUS 48
+
+layout(local_size_x = TILE) in;
+
+uniform highp sampler2D tex;
+layout(rgba16f, binding = 0) writeonly uniform image2D dst;
+
+uniform int   lod; // level of tex to read, the size of that level is the size of dst
+uniform ivec2 size;
+uniform int   radius; // in taps, at most MAXRADIUS
+uniform float weights[MAXRADIUS + 1]; // normalized, center first
+
+// horizontal pass only, reads the unblurred image
+uniform float contrast;
+uniform float brightness;
 
-uniform float     contrast;
-uniform float     brightness;
+shared vec4   tile[TILE + 2 * MAXRADIUS];
 
 float gain(float x, float k) {
     float a = 0.5 * pow(2.0 * ((x < 0.5) ? x : 1.0 - x), k);
     return (x < 0.5) ? a : 1.0 - a;
 }
 
-void main() {
-    vec4 pixColor = texture2D(tex, v_texcoord);
+vec4 fetch(int along, int line) {
+#if DIRECTION == 0
+    vec4 pixColor = texelFetch(tex, ivec2(along, line), lod);
 
     // contrast
     if (contrast != 1.0) {
@@ -370,47 +455,44 @@ void main() {
         pixColor.rgb *= brightness;
     }
 
-    gl_FragColor = pixColor;
-}
-)#";
-
-inline const std::string FRAGBLURFINISH = R"#(
-precision         highp float;
-varying vec2      v_texcoord; // is in 0-1
-uniform sampler2D tex;
-
-uniform float     noise;
-uniform float     brightness;
-
-uniform int       colorize;
-uniform vec3      colorizeTint;
-uniform float     boostA;
-
-float hash(vec2 p) {
-    return fract(sin(dot(p, vec2(12.9898, 78.233))) * 43758.5453);
+    return pixColor;
+#else
+    return texelFetch(tex, ivec2(line, along), lod);
+#endif
 }
 
 void main() {
-    vec4 pixColor = texture2D(tex, v_texcoord);
-
-    // noise
-    float noiseHash   = hash(v_texcoord);
-    float noiseAmount = (mod(noiseHash, 1.0) - 0.5);
-    pixColor.rgb += noiseAmount * noise;
-
-    // brightness
-    if (brightness < 1.0) {
-        pixColor.rgb *= brightness;
+#if DIRECTION == 0
+    int len = size.x;
+#else
+    int len = size.y;
+#endif
+
+    int line  = int(gl_WorkGroupID.y);
+    int start = int(gl_WorkGroupID.x) * TILE;
+    int local = int(gl_LocalInvocationID.x);
+
+    // every texel of the tile and its apron is read once, edges are clamped
+    for (int i = local; i < TILE + 2 * radius; i += TILE) {
+        tile[i] = fetch(clamp(start - radius + i, 0, len - 1), line);
     }
 
-    pixColor.a *= boostA;
+    barrier();
 
-    if (colorize == 1) {
-        gl_FragColor = vec4(colorizeTint.r * pixColor.a, colorizeTint.g * pixColor.a, colorizeTint.b * pixColor.a, pixColor.a);
+    int along = start + local;
+    if (along >= len)
         return;
+
+    vec4 sum = tile[local + radius] * weights[0];
+    for (int i = 1; i <= radius; ++i) {
+        sum += (tile[local + radius - i] + tile[local + radius + i]) * weights[i];
     }
 
-    gl_FragColor = pixColor;
+#if DIRECTION == 0
+    imageStore(dst, ivec2(along, line), sum);
+#else
+    imageStore(dst, ivec2(line, along), sum);
+#endif
 }
 )#";
 
@@ -593,4 +675,27 @@ void main() {
 
     gl_FragColor = pixColor;
 }
-)#";
\ No newline at end of file
+)#";
+// one instance per glyph, box and uv come from the glyph atlas
+inline const std::string GLYPHVERTSRC = R"#(
+uniform mat3 proj;
+attribute vec2 pos;
+attribute vec4 glyphBox;
+attribute vec4 glyphUV;
+varying vec2 v_texcoord;
+
+void main() {
+    gl_Position = vec4(proj * vec3(glyphBox.xy + pos * glyphBox.zw, 1.0), 1.0);
+    v_texcoord = glyphUV.xy + pos * glyphUV.zw;
+})#";
+
+inline const std::string GLYPHFRAGSRC = R"#(
+precision highp float;
+varying vec2 v_texcoord;
+uniform sampler2D tex;
+uniform vec4 color;
+
+void main() {
+    // the atlas is white, only its coverage matters
+    gl_FragColor = vec4(color.rgb * color.a, color.a) * texture2D(tex, v_texcoord).a;
+})#";
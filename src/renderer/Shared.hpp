@@ -2,6 +2,11 @@
 #include "Texture.hpp"
 #include "../defines.hpp"
 
+// Opaque handle of an asset, 0 means no asset.
+// The gatherer hands them out sequentially and matches equal requests by their key in assetIDs,
+// screencopy handles are a std::hash of the output's port and size.
+using ResourceID = size_t;
+
 struct SPreloadedAsset {
     CTexture texture;
     bool     ready = false;
@@ -7,15 +7,39 @@
 #include "../../helpers/MiscFunctions.hpp"
 #include "../../core/AnimationManager.hpp"
 #include "../../config/ConfigManager.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <hyprlang.hpp>
+#include <hyprutils/os/FileDescriptor.hpp>
 #include <filesystem>
+#include <fstream>
 #include <memory>
 #include <GLES3/gl32.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace Hyprutils::OS;
+
+// Header of a background cache file, followed by width * height pixels of 4 bytes each.
+// Pixels are kept in the format of blurredFB (see CFramebuffer::alloc), so a warm start shows the exact same texture as a cold one.
+struct SBackgroundCacheHeader {
+    uint32_t magic   = 0x47424c48; // HLBG
+    uint32_t version = 2;
+    uint32_t width   = 0;
+    uint32_t height  = 0;
+    uint32_t format  = GL_RGB10_A2;
+};
+
+constexpr GLenum CACHEPIXELTYPE = GL_UNSIGNED_INT_2_10_10_10_REV;
+
+// Old wallpapers or monitor setups should not pile up in the cache dir
+constexpr size_t MAXCACHEDBACKGROUNDS = 16;
 
 CBackground::CBackground() {
-    blurredFB        = makeUnique<CFramebuffer>();
-    pendingBlurredFB = makeUnique<CFramebuffer>();
+    blurredFB        = makeShared<CFramebuffer>();
+    pendingBlurredFB = makeShared<CFramebuffer>();
     transformedScFB  = makeUnique<CFramebuffer>();
 }
 
@@ -62,18 +86,35 @@ void CBackground::configure(const std::unordered_map<std::string, std::any>& pro
     // Dynamic ones are tricky, because a screencopy would copy hyprlock itself.
     if (g_pRenderer->asyncResourceGatherer->gathered && !g_pRenderer->asyncResourceGatherer->getAssetByID(scResourceID)) {
         Debug::log(LOG, "Missing screenshot for output {}", outputPort);
-        scResourceID = "";
+        scResourceID = 0;
     }
 
     if (isScreenshot) {
-        resourceID = scResourceID; // Fallback to solid background:color when scResourceID==""
+        resourceID = scResourceID; // Fallback to solid background:color when scResourceID==0
 
         if (!g_pHyprlock->getScreencopy()) {
             Debug::log(ERR, "No screencopy support! path=screenshot won't work. Falling back to background color.");
-            resourceID = "";
+            resourceID = 0;
         }
-    } else if (!path.empty())
-        resourceID = "background:" + path;
+    } else if (!path.empty()) {
+        static const auto BACKGROUNDCACHE = g_pConfigManager->getValue<Hyprlang::INT>("general:background_cache");
+
+        // Only blurring is worth caching. Skips both the decode and the blur on a hit.
+        if (*BACKGROUNDCACHE && blurPasses > 0)
+            cacheFile = getCacheFile(props, viewport, transform);
+
+        if (!cacheFile.empty() && loadCachedFB()) {
+            Debug::log(LOG, "Using cached background {} for output {}", cacheFile, outputPort);
+            primaryFromCache = true;
+        } else {
+            // shares the texture with the initial gather and other outputs
+            CAsyncResourceGatherer::SPreloadRequest rq;
+            rq.asset               = path;
+            rq.type                = CAsyncResourceGatherer::eTargetType::TARGET_IMAGE;
+            rq.props["cover_size"] = viewport;
+            resourceID             = g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(rq);
+        }
+    }
 
     if (!isScreenshot && reloadTime > -1) {
         try {
@@ -90,12 +131,32 @@ void CBackground::reset() {
         reloadTimer.reset();
     }
 
-    blurredFB->destroyBuffer();
-    pendingBlurredFB->destroyBuffer();
+    // other outputs may still show them
+    blurredFB        = makeShared<CFramebuffer>();
+    pendingBlurredFB = makeShared<CFramebuffer>();
+
+    cacheFile.clear();
+    primaryFromCache = false;
+
+    if (g_pHyprlock->m_bTerminate)
+        return;
+
+    // screenshots are owned by the gatherer, unloading them is a noop
+    if (resourceID)
+        g_pRenderer->asyncResourceGatherer->unloadAsset(resourceID);
+
+    if (pendingResourceID)
+        g_pRenderer->asyncResourceGatherer->unloadAsset(pendingResourceID);
+
+    asset             = nullptr;
+    pendingAsset      = nullptr;
+    scAsset           = nullptr;
+    resourceID        = 0;
+    pendingResourceID = 0;
 }
 
 void CBackground::updatePrimaryAsset() {
-    if (asset || resourceID.empty())
+    if (asset || !resourceID)
         return;
 
     asset = g_pRenderer->asyncResourceGatherer->getAssetByID(resourceID);
@@ -103,8 +164,144 @@ void CBackground::updatePrimaryAsset() {
         return;
 
     const bool NEEDFB = (isScreenshot || blurPasses > 0 || asset->texture.m_vSize != viewport || transform != HYPRUTILS_TRANSFORM_NORMAL) && (!blurredFB->isAllocated() || firstRender);
-    if (NEEDFB)
-        renderToFB(asset->texture, *blurredFB, blurPasses, isScreenshot);
+    if (NEEDFB) {
+        const bool RENDERED = renderToSharedFB(asset->texture, resourceID, blurredFB, isScreenshot);
+
+        // a shared one was written by the output that rendered it
+        if (RENDERED && !cacheFile.empty() && asset->texture.m_iType != TEXTURE_INVALID)
+            writeCachedFB();
+    }
+}
+
+bool CBackground::renderToSharedFB(const CTexture& tex, ResourceID id, SP<CFramebuffer>& fb, bool applyTransform) {
+    // the resource id already covers the path, its mtime and the decoded size
+    const auto KEY = std::format("{}:{}x{}:{}:{}:{}:{}:{}:{}:{}:{}:{}", id, viewport.x, viewport.y, (int)transform, applyTransform, blurSize, blurPasses, noise, contrast,
+                                 brightness, vibrancy, vibrancy_darkness);
+
+    if (const auto SHARED = g_pRenderer->getSharedBlur(KEY); SHARED) {
+        Debug::log(LOG, "Reusing the blurred background of another output for {}", outputPort);
+        fb          = SHARED;
+        firstRender = false;
+        return false;
+    }
+
+    // never render into one that another output might be showing
+    fb = makeShared<CFramebuffer>();
+    renderToFB(tex, *fb, blurPasses, applyTransform);
+    g_pRenderer->addSharedBlur(KEY, fb);
+    return true;
+}
+
+std::string CBackground::getCacheFile(const std::unordered_map<std::string, std::any>& props, const Vector2D& viewport, Hyprutils::Math::eTransform transform) {
+    static const auto BLURENGINE = g_pConfigManager->getValue<Hyprlang::INT>("general:blur_engine");
+
+    const auto        CACHEDIR = getCacheDir();
+    const std::string PATH     = std::any_cast<Hyprlang::STRING>(props.at("path"));
+
+    if (CACHEDIR.empty() || PATH.empty() || PATH == "screenshot")
+        return "";
+
+    const auto      ABSOLUTEPATH = absolutePath(PATH, "");
+    std::error_code ec;
+    const auto      MTIME = std::filesystem::last_write_time(ABSOLUTEPATH, ec);
+    if (ec)
+        return "";
+
+    // everything that ends up in blurredFB
+    const auto KEY = std::format("{}:{}:{}x{}:{}:{}:{}:{}:{}:{}:{}:{}:{}", ABSOLUTEPATH, MTIME.time_since_epoch().count(), viewport.x, viewport.y, (int)transform,
+                                 std::any_cast<Hyprlang::INT>(props.at("blur_size")), std::any_cast<Hyprlang::INT>(props.at("blur_passes")),
+                                 std::any_cast<Hyprlang::FLOAT>(props.at("noise")), std::any_cast<Hyprlang::FLOAT>(props.at("contrast")),
+                                 std::any_cast<Hyprlang::FLOAT>(props.at("brightness")), std::any_cast<Hyprlang::FLOAT>(props.at("vibrancy")),
+                                 std::any_cast<Hyprlang::FLOAT>(props.at("vibrancy_darkness")), *BLURENGINE);
+
+    return std::format("{}/{:016x}.bg", CACHEDIR, std::hash<std::string>{}(KEY));
+}
+
+bool CBackground::loadCachedFB() {
+    CFileDescriptor fd{open(cacheFile.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!fd.isValid())
+        return false;
+
+    const size_t PIXELSIZE = (size_t)viewport.x * (size_t)viewport.y * 4;
+    struct stat  st;
+    if (fstat(fd.get(), &st) != 0 || (size_t)st.st_size != sizeof(SBackgroundCacheHeader) + PIXELSIZE) {
+        Debug::log(WARN, "Ignoring background cache {} with unexpected size", cacheFile);
+        return false;
+    }
+
+    const auto DATA = (uint8_t*)mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if (DATA == MAP_FAILED) {
+        Debug::log(ERR, "Failed to mmap background cache {}: {}", cacheFile, strerror(errno));
+        return false;
+    }
+
+    const SBackgroundCacheHeader EXPECTED{.width = (uint32_t)viewport.x, .height = (uint32_t)viewport.y};
+    const auto                   HEADER = (const SBackgroundCacheHeader*)DATA;
+    if (HEADER->magic != EXPECTED.magic || HEADER->version != EXPECTED.version || HEADER->width != EXPECTED.width || HEADER->height != EXPECTED.height ||
+        HEADER->format != EXPECTED.format) {
+        Debug::log(WARN, "Ignoring invalid background cache {}", cacheFile);
+        munmap(DATA, st.st_size);
+        return false;
+    }
+
+    blurredFB->alloc(viewport.x, viewport.y);
+
+    // rows are stored the way glReadPixels returns them
+    glBindTexture(GL_TEXTURE_2D, blurredFB->m_cTex.m_iTexID);
+    glTexImage2D(GL_TEXTURE_2D, 0, HEADER->format, viewport.x, viewport.y, 0, GL_RGBA, CACHEPIXELTYPE, DATA + sizeof(SBackgroundCacheHeader));
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    munmap(DATA, st.st_size);
+    return true;
+}
+
+void CBackground::writeCachedFB() {
+    const SBackgroundCacheHeader HEADER{.width = (uint32_t)blurredFB->m_vSize.x, .height = (uint32_t)blurredFB->m_vSize.y};
+    std::vector<uint8_t>         data(sizeof(SBackgroundCacheHeader) + (size_t)HEADER.width * HEADER.height * 4);
+    std::memcpy(data.data(), &HEADER, sizeof(SBackgroundCacheHeader));
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, blurredFB->m_iFb);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, HEADER.width, HEADER.height, GL_RGBA, CACHEPIXELTYPE, data.data() + sizeof(SBackgroundCacheHeader));
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    const std::filesystem::path CACHEPATH{cacheFile};
+    std::error_code             ec;
+    std::filesystem::create_directories(CACHEPATH.parent_path(), ec);
+
+    // write to a temporary file first, so that a concurrent instance never reads a partial one
+    const auto TMPPATH = cacheFile + ".tmp";
+    {
+        std::ofstream ofs(TMPPATH, std::ios::binary | std::ios::trunc);
+        ofs.write((const char*)data.data(), data.size());
+        if (!ofs.good()) {
+            Debug::log(ERR, "Failed to write background cache {}", TMPPATH);
+            std::filesystem::remove(TMPPATH, ec);
+            return;
+        }
+    }
+
+    std::filesystem::rename(TMPPATH, CACHEPATH, ec);
+    if (ec) {
+        Debug::log(ERR, "Failed to write background cache {}: {}", cacheFile, ec.message());
+        return;
+    }
+
+    Debug::log(LOG, "Wrote background cache {}", cacheFile);
+
+    std::vector<std::filesystem::directory_entry> cached;
+    for (const auto& e : std::filesystem::directory_iterator(CACHEPATH.parent_path(), ec)) {
+        if (e.path().extension() == ".bg")
+            cached.emplace_back(e);
+    }
+
+    if (cached.size() <= MAXCACHEDBACKGROUNDS)
+        return;
+
+    std::ranges::sort(cached, [](const auto& a, const auto& b) { return a.last_write_time() > b.last_write_time(); });
+    for (size_t i = MAXCACHEDBACKGROUNDS; i < cached.size(); ++i) {
+        std::filesystem::remove(cached[i].path(), ec);
+    }
 }
 
 void CBackground::updatePendingAsset() {
@@ -112,11 +309,11 @@ void CBackground::updatePendingAsset() {
     if (!pendingAsset || blurPasses == 0 || pendingBlurredFB->isAllocated())
         return;
 
-    renderToFB(pendingAsset->texture, *pendingBlurredFB, blurPasses);
+    renderToSharedFB(pendingAsset->texture, pendingResourceID, pendingBlurredFB);
 }
 
 void CBackground::updateScAsset() {
-    if (scAsset || scResourceID.empty())
+    if (scAsset || !scResourceID)
         return;
 
     // path=screenshot -> scAsset = asset
@@ -220,13 +417,14 @@ bool CBackground::draw(const SRenderData& data) {
     updateScAsset();
 
     if (asset && asset->texture.m_iType == TEXTURE_INVALID) {
-        g_pRenderer->asyncResourceGatherer->unloadAsset(asset);
-        resourceID = "";
+        g_pRenderer->asyncResourceGatherer->unloadAsset(resourceID);
+        asset      = nullptr;
+        resourceID = 0;
         renderRect(color);
         return false;
     }
 
-    if (!asset || resourceID.empty()) {
+    if (!primaryFromCache && (!asset || !resourceID)) {
         // fade in/out with a solid color
         if (data.opacity < 1.0 && scAsset) {
             const auto& SCTEX    = getScAssetTex();
@@ -239,7 +437,7 @@ bool CBackground::draw(const SRenderData& data) {
         }
 
         renderRect(color);
-        return !asset && !resourceID.empty(); // resource not ready
+        return !asset && resourceID; // resource not ready
     }
 
     const auto& TEX    = getPrimaryAssetTex();
@@ -294,29 +492,34 @@ void CBackground::onReloadTimerUpdate() {
         return;
     }
 
-    if (!pendingResourceID.empty())
+    if (pendingResourceID)
         return;
 
     // Issue the next request
 
-    request.id        = std::string{"background:"} + path + ",time:" + std::to_string((uint64_t)modificationTime.time_since_epoch().count());
-    pendingResourceID = request.id;
-    request.asset     = path;
-    request.type      = CAsyncResourceGatherer::eTargetType::TARGET_IMAGE;
+    request.asset    = path;
+    request.type     = CAsyncResourceGatherer::eTargetType::TARGET_IMAGE;
+    request.priority = CAsyncResourceGatherer::PRIORITY_LOW;
 
     request.callback = [REF = m_self]() { onAssetCallback(REF); };
 
-    g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
+    request.props["cover_size"] = viewport;
+
+    pendingResourceID = g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
 }
 
 void CBackground::startCrossFade() {
     auto newAsset = g_pRenderer->asyncResourceGatherer->getAssetByID(pendingResourceID);
     if (newAsset) {
         if (newAsset->texture.m_iType == TEXTURE_INVALID) {
-            g_pRenderer->asyncResourceGatherer->unloadAsset(newAsset);
+            g_pRenderer->asyncResourceGatherer->unloadAsset(pendingResourceID);
             Debug::log(ERR, "New asset had an invalid texture!");
-            pendingResourceID = "";
-        } else if (resourceID != pendingResourceID) {
+            pendingResourceID = 0;
+        } else if (resourceID == pendingResourceID) {
+            // same content, nothing to fade to
+            g_pRenderer->asyncResourceGatherer->unloadAsset(pendingResourceID);
+            pendingResourceID = 0;
+        } else {
             pendingAsset = newAsset;
             crossFadeProgress->setValueAndWarp(0);
             *crossFadeProgress = 1.0;
@@ -324,21 +527,22 @@ void CBackground::startCrossFade() {
             crossFadeProgress->setCallbackOnEnd(
                 [REF = m_self](auto) {
                     if (const auto PSELF = REF.lock()) {
-                        PSELF->asset        = PSELF->pendingAsset;
-                        PSELF->pendingAsset = nullptr;
-                        g_pRenderer->asyncResourceGatherer->unloadAsset(PSELF->pendingAsset);
+                        g_pRenderer->asyncResourceGatherer->unloadAsset(PSELF->resourceID);
+                        PSELF->asset             = PSELF->pendingAsset;
+                        PSELF->pendingAsset      = nullptr;
                         PSELF->resourceID        = PSELF->pendingResourceID;
-                        PSELF->pendingResourceID = "";
+                        PSELF->pendingResourceID = 0;
+                        PSELF->primaryFromCache  = false;
 
-                        PSELF->blurredFB->destroyBuffer();
-                        PSELF->blurredFB = std::move(PSELF->pendingBlurredFB);
+                        PSELF->blurredFB        = PSELF->pendingBlurredFB;
+                        PSELF->pendingBlurredFB = makeShared<CFramebuffer>();
                     }
                 },
                 true);
 
             g_pHyprlock->renderOutput(outputPort);
         }
-    } else if (!pendingResourceID.empty()) {
+    } else if (pendingResourceID) {
         Debug::log(WARN, "Asset {} not available after the asyncResourceGatherer's callback!", pendingResourceID);
         g_pHyprlock->addTimer(std::chrono::milliseconds(100), [REF = m_self](auto, auto) { onAssetCallback(REF); }, nullptr);
     }
@@ -45,12 +45,20 @@ class CBackground : public IWidget {
     void            plantReloadTimer();
     void            startCrossFade();
 
+    // Cache file for the blurred background described by props, empty if it can't be cached.
+    static std::string getCacheFile(const std::unordered_map<std::string, std::any>& props, const Vector2D& viewport, Hyprutils::Math::eTransform transform);
+
   private:
     AWP<CBackground> m_self;
 
-    // if needed
-    UP<CFramebuffer>                        blurredFB;
-    UP<CFramebuffer>                        pendingBlurredFB;
+    bool             loadCachedFB();
+    void             writeCachedFB();
+    // Renders tex into a new fb, unless another output already rendered the same thing. Returns false in that case.
+    bool             renderToSharedFB(const CTexture& tex, ResourceID id, SP<CFramebuffer>& fb, bool applyTransform = false);
+
+    // if needed, the blurred ones may be shared with other outputs
+    SP<CFramebuffer>                        blurredFB;
+    SP<CFramebuffer>                        pendingBlurredFB;
     UP<CFramebuffer>                        transformedScFB;
 
     int                                     blurSize          = 10;
@@ -66,9 +74,9 @@ class CBackground : public IWidget {
     std::string                             outputPort;
     Hyprutils::Math::eTransform             transform;
 
-    std::string                             resourceID;
-    std::string                             scResourceID;
-    std::string                             pendingResourceID;
+    ResourceID                              resourceID        = 0;
+    ResourceID                              scResourceID      = 0;
+    ResourceID                              pendingResourceID = 0;
 
     PHLANIMVAR<float>                       crossFadeProgress;
 
@@ -79,6 +87,9 @@ class CBackground : public IWidget {
     bool                                    isScreenshot = false;
     bool                                    firstRender  = true;
 
+    std::string                             cacheFile;
+    bool                                    primaryFromCache = false; // blurredFB was loaded from cacheFile
+
     int                                     reloadTime = -1;
     std::string                             reloadCommand;
     CAsyncResourceGatherer::SPreloadRequest request;
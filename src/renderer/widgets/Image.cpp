@@ -56,16 +56,17 @@ void CImage::onTimerUpdate() {
         return;
     }
 
-    if (!pendingResourceID.empty())
+    if (pendingResourceID)
         return;
 
-    request.id        = std::string{"image:"} + path + ",time:" + std::to_string((uint64_t)modificationTime.time_since_epoch().count());
-    pendingResourceID = request.id;
-    request.asset     = path;
-    request.type      = CAsyncResourceGatherer::eTargetType::TARGET_IMAGE;
-    request.callback  = [REF = m_self]() { onAssetCallback(REF); };
+    request.asset    = path;
+    request.type     = CAsyncResourceGatherer::eTargetType::TARGET_IMAGE;
+    request.priority = CAsyncResourceGatherer::PRIORITY_LOW;
+    request.callback = [REF = m_self]() { onAssetCallback(REF); };
 
-    g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
+    request.props["cover_size"] = Vector2D{(double)size, (double)size};
+
+    pendingResourceID = g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
 }
 
 void CImage::plantTimer() {
@@ -104,8 +105,16 @@ void CImage::configure(const std::unordered_map<std::string, std::any>& props, c
         RASSERT(false, "Missing propperty for CImage: {}", e.what()); //
     }
 
-    resourceID = "image:" + path;
-    angle      = angle * M_PI / 180.0;
+    angle = angle * M_PI / 180.0;
+
+    if (!path.empty()) {
+        // shares the texture with the initial gather
+        CAsyncResourceGatherer::SPreloadRequest rq;
+        rq.asset               = path;
+        rq.type                = CAsyncResourceGatherer::eTargetType::TARGET_IMAGE;
+        rq.props["cover_size"] = Vector2D{(double)size, (double)size};
+        resourceID             = g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(rq);
+    }
 
     if (reloadTime > -1) {
         try {
@@ -127,17 +136,20 @@ void CImage::reset() {
 
     imageFB.destroyBuffer();
 
-    if (asset && reloadTime > -1) // Don't unload asset if it's a static image
-        g_pRenderer->asyncResourceGatherer->unloadAsset(asset);
+    if (resourceID)
+        g_pRenderer->asyncResourceGatherer->unloadAsset(resourceID);
+
+    if (pendingResourceID)
+        g_pRenderer->asyncResourceGatherer->unloadAsset(pendingResourceID);
 
     asset             = nullptr;
-    pendingResourceID = "";
-    resourceID        = "";
+    pendingResourceID = 0;
+    resourceID        = 0;
 }
 
 bool CImage::draw(const SRenderData& data) {
 
-    if (resourceID.empty())
+    if (!resourceID)
         return false;
 
     if (!asset)
@@ -147,8 +159,9 @@ bool CImage::draw(const SRenderData& data) {
         return true;
 
     if (asset->texture.m_iType == TEXTURE_INVALID) {
-        g_pRenderer->asyncResourceGatherer->unloadAsset(asset);
-        resourceID = "";
+        g_pRenderer->asyncResourceGatherer->unloadAsset(resourceID);
+        asset      = nullptr;
+        resourceID = 0;
         return false;
     }
 
@@ -191,6 +204,9 @@ bool CImage::draw(const SRenderData& data) {
     CTexture* tex    = &imageFB.m_cTex;
     CBox      texbox = {{}, tex->m_vSize};
 
+    // the shadow is rendered around the bounding box
+    pos = posFromHVAlign(viewport, tex->m_vSize, configPos, halign, valign, angle);
+
     if (firstRender) {
         firstRender = false;
         shadow.markShadowDirty();
@@ -198,8 +214,6 @@ bool CImage::draw(const SRenderData& data) {
 
     shadow.draw(data);
 
-    pos = posFromHVAlign(viewport, tex->m_vSize, configPos, halign, valign, angle);
-
     texbox.x = pos.x;
     texbox.y = pos.y;
 
@@ -213,21 +227,22 @@ bool CImage::draw(const SRenderData& data) {
 void CImage::renderUpdate() {
     auto newAsset = g_pRenderer->asyncResourceGatherer->getAssetByID(pendingResourceID);
     if (newAsset) {
-        if (newAsset->texture.m_iType == TEXTURE_INVALID) {
-            g_pRenderer->asyncResourceGatherer->unloadAsset(newAsset);
-        } else if (resourceID != pendingResourceID) {
-            g_pRenderer->asyncResourceGatherer->unloadAsset(asset);
+        if (newAsset->texture.m_iType == TEXTURE_INVALID || resourceID == pendingResourceID) {
+            g_pRenderer->asyncResourceGatherer->unloadAsset(pendingResourceID);
+        } else {
+            g_pRenderer->asyncResourceGatherer->unloadAsset(resourceID);
             imageFB.destroyBuffer();
 
             asset       = newAsset;
             resourceID  = pendingResourceID;
             firstRender = true;
         }
-        pendingResourceID = "";
-    } else if (!pendingResourceID.empty()) {
+        pendingResourceID = 0;
+    } else if (pendingResourceID) {
         Debug::log(WARN, "Asset {} not available after the asyncResourceGatherer's callback!", pendingResourceID);
-        pendingResourceID = "";
-    } else if (!pendingResourceID.empty()) {
+        g_pRenderer->asyncResourceGatherer->unloadAsset(pendingResourceID);
+        pendingResourceID = 0;
+    } else if (pendingResourceID) {
         Debug::log(WARN, "Asset {} not available after the asyncResourceGatherer's callback!", pendingResourceID);
 
         g_pHyprlock->addTimer(std::chrono::milliseconds(100), [REF = m_self](auto, auto) { onAssetCallback(REF); }, nullptr);
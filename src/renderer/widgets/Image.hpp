@@ -62,8 +62,8 @@ class CImage : public IWidget {
     Vector2D                                viewport;
     std::string                             stringPort;
 
-    std::string                             resourceID;
-    std::string                             pendingResourceID; // if reloading image
-    SPreloadedAsset*                        asset = nullptr;
+    ResourceID                              resourceID        = 0;
+    ResourceID                              pendingResourceID = 0; // if reloading image
+    SPreloadedAsset*                        asset             = nullptr;
     CShadowable                             shadow;
 };
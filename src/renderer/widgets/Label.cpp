@@ -5,6 +5,7 @@
 #include "../../helpers/Color.hpp"
 #include "../../helpers/MiscFunctions.hpp"
 #include "../../config/ConfigDataValues.hpp"
+#include "../../config/ConfigManager.hpp"
 #include <hyprlang.hpp>
 #include <stdexcept>
 
@@ -30,10 +31,6 @@ static void onAssetCallback(AWP<CLabel> ref) {
         PLABEL->renderUpdate();
 }
 
-std::string CLabel::getUniqueResourceId() {
-    return std::string{"label:"} + std::to_string((uintptr_t)this) + ",time:" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
-}
-
 void CLabel::onTimerUpdate() {
     std::string oldFormatted = label.formatted;
 
@@ -42,19 +39,22 @@ void CLabel::onTimerUpdate() {
     if (label.formatted == oldFormatted && !label.alwaysUpdate)
         return;
 
-    if (!pendingResourceID.empty()) {
+    if (glyphAtlas) {
+        glyphsDirty = true;
+        g_pHyprlock->renderOutput(outputStringPort);
+        return;
+    }
+
+    if (pendingResourceID) {
         Debug::log(WARN, "Trying to update label, but resource {} is still pending! Skipping update.", pendingResourceID);
         return;
     }
 
     // request new
-    request.id        = getUniqueResourceId();
-    pendingResourceID = request.id;
-    request.asset     = label.formatted;
-
+    request.asset    = label.formatted;
     request.callback = [REF = m_self]() { onAssetCallback(REF); };
 
-    g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
+    pendingResourceID = g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
 }
 
 void CLabel::plantTimer() {
@@ -82,25 +82,28 @@ void CLabel::configure(const std::unordered_map<std::string, std::any>& props, c
         angle          = angle * M_PI / 180.0;
         onclickCommand = std::any_cast<Hyprlang::STRING>(props.at("onclick"));
 
-        std::string textAlign  = std::any_cast<Hyprlang::STRING>(props.at("text_align"));
         std::string fontFamily = std::any_cast<Hyprlang::STRING>(props.at("font_family"));
-        CHyprColor  labelColor = std::any_cast<Hyprlang::INT>(props.at("color"));
         int         fontSize   = std::any_cast<Hyprlang::INT>(props.at("font_size"));
+        textAlign              = std::any_cast<Hyprlang::STRING>(props.at("text_align"));
+        labelColor             = std::any_cast<Hyprlang::INT>(props.at("color"));
 
         label = formatString(labelPreFormat);
 
-        request.id                   = getUniqueResourceId();
-        resourceID                   = request.id;
         request.asset                = label.formatted;
         request.type                 = CAsyncResourceGatherer::eTargetType::TARGET_TEXT;
         request.props["font_family"] = fontFamily;
         request.props["color"]       = labelColor;
         request.props["font_size"]   = fontSize;
         request.props["cmd"]         = label.cmd;
+        request.props["update_ms"]   = (int)label.updateEveryMs;
 
         if (!textAlign.empty())
             request.props["text_align"] = textAlign;
 
+        // a static label is rendered once, the atlas only pays off for ones that change
+        if (!label.cmd && label.updateEveryMs != 0)
+            glyphAtlas = g_pRenderer->getGlyphAtlas(fontFamily, fontSize);
+
     } catch (const std::bad_any_cast& e) {
         RASSERT(false, "Failed to construct CLabel: {}", e.what()); //
     } catch (const std::out_of_range& e) {
@@ -109,7 +112,10 @@ void CLabel::configure(const std::unordered_map<std::string, std::any>& props, c
 
     pos = configPos; // Label size not known yet
 
-    g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
+    if (glyphAtlas)
+        glyphsDirty = true;
+    else
+        resourceID = g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
 
     plantTimer();
 }
@@ -123,22 +129,88 @@ void CLabel::reset() {
     if (g_pHyprlock->m_bTerminate)
         return;
 
-    if (asset)
-        g_pRenderer->asyncResourceGatherer->unloadAsset(asset);
+    if (resourceID)
+        g_pRenderer->asyncResourceGatherer->unloadAsset(resourceID);
+
+    if (pendingResourceID)
+        g_pRenderer->asyncResourceGatherer->unloadAsset(pendingResourceID);
+
+    asset             = nullptr;
+    pendingResourceID = 0;
+    resourceID        = 0;
+    glyphAtlas        = nullptr;
+    glyphsDirty       = false;
+    glyphsShown       = false;
+}
+
+bool CLabel::renderGlyphs() {
+    static const auto TRIM = g_pConfigManager->getValue<Hyprlang::INT>("general:text_trim");
+    std::string       text = label.formatted;
+
+    if (*TRIM) {
+        text.erase(0, text.find_first_not_of(" \n\r\t"));
+        text.erase(text.find_last_not_of(" \n\r\t") + 1);
+    }
+
+    const auto SHAPED = glyphAtlas->shape(text, textAlign);
+    if (!SHAPED)
+        return false;
+
+    glyphFB.alloc(std::max(SHAPED->size.x, 1.0), std::max(SHAPED->size.y, 1.0), true);
+    g_pRenderer->pushFb(glyphFB.m_iFb);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-    asset = nullptr;
-    pendingResourceID.clear();
-    resourceID.clear();
+    g_pRenderer->renderGlyphs(glyphAtlas->texture, SHAPED->quads, labelColor);
+    g_pRenderer->popFb();
+
+    return true;
+}
+
+const CTexture* CLabel::getTexture() const {
+    if (glyphsShown)
+        return &glyphFB.m_cTex;
+
+    return asset ? &asset->texture : nullptr;
 }
 
 bool CLabel::draw(const SRenderData& data) {
-    if (!asset) {
+    if (glyphsDirty) {
+        glyphsDirty = false;
+
+        if (renderGlyphs()) {
+            // drop whatever the gatherer had for us
+            if (resourceID)
+                g_pRenderer->asyncResourceGatherer->unloadAsset(resourceID);
+            if (pendingResourceID)
+                g_pRenderer->asyncResourceGatherer->unloadAsset(pendingResourceID);
+
+            asset             = nullptr;
+            resourceID        = 0;
+            pendingResourceID = 0;
+            glyphsShown       = true;
+            updateShadow      = true;
+        } else if (!pendingResourceID) {
+            Debug::log(TRACE, "Label {} can't be drawn from the glyph atlas", label.formatted);
+
+            request.asset     = label.formatted;
+            request.callback  = [REF = m_self]() { onAssetCallback(REF); };
+            pendingResourceID = g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
+        }
+    }
+
+    if (!glyphsShown && !asset) {
         asset = g_pRenderer->asyncResourceGatherer->getAssetByID(resourceID);
 
         if (!asset)
             return true;
     }
 
+    const auto TEX = getTexture();
+
+    // calc pos, the shadow is rendered around the bounding box
+    pos = posFromHVAlign(viewport, TEX->m_vSize, configPos, halign, valign, angle);
+
     if (updateShadow) {
         updateShadow = false;
         shadow.markShadowDirty();
@@ -146,25 +218,27 @@ bool CLabel::draw(const SRenderData& data) {
 
     shadow.draw(data);
 
-    // calc pos
-    pos = posFromHVAlign(viewport, asset->texture.m_vSize, configPos, halign, valign, angle);
-
-    CBox box = {pos.x, pos.y, asset->texture.m_vSize.x, asset->texture.m_vSize.y};
+    CBox box = {pos.x, pos.y, TEX->m_vSize.x, TEX->m_vSize.y};
     box.rot  = angle;
-    g_pRenderer->renderTexture(box, asset->texture, data.opacity);
+    g_pRenderer->renderTexture(box, *TEX, data.opacity);
 
     return false;
 }
 
 void CLabel::renderUpdate() {
+    // the glyph atlas got there first
+    if (!pendingResourceID)
+        return;
+
     auto newAsset = g_pRenderer->asyncResourceGatherer->getAssetByID(pendingResourceID);
     if (newAsset) {
         // new asset is ready :D
-        g_pRenderer->asyncResourceGatherer->unloadAsset(asset);
+        g_pRenderer->asyncResourceGatherer->unloadAsset(resourceID);
         asset             = newAsset;
         resourceID        = pendingResourceID;
-        pendingResourceID = "";
+        pendingResourceID = 0;
         updateShadow      = true;
+        glyphsShown       = false;
     } else {
         Debug::log(WARN, "Asset {} not available after the asyncResourceGatherer's callback!", pendingResourceID);
 
@@ -176,12 +250,13 @@ void CLabel::renderUpdate() {
 }
 
 CBox CLabel::getBoundingBoxWl() const {
-    if (!asset)
+    const auto TEX = getTexture();
+    if (!TEX)
         return CBox{};
 
     return {
-        Vector2D{pos.x, viewport.y - pos.y - asset->texture.m_vSize.y},
-        asset->texture.m_vSize,
+        Vector2D{pos.x, viewport.y - pos.y - TEX->m_vSize.y},
+        TEX->m_vSize,
     };
 }
 
@@ -3,13 +3,16 @@
 #include "IWidget.hpp"
 #include "Shadowable.hpp"
 #include "../../helpers/Math.hpp"
+#include "../../helpers/Color.hpp"
 #include "../../core/Timer.hpp"
 #include "../AsyncResourceGatherer.hpp"
+#include "../Framebuffer.hpp"
 #include <string>
 #include <unordered_map>
 #include <any>
 
 struct SPreloadedAsset;
+class CGlyphAtlas;
 class CSessionLockSurface;
 
 class CLabel : public IWidget {
@@ -32,9 +35,10 @@ class CLabel : public IWidget {
     void         plantTimer();
 
   private:
-    AWP<CLabel>                             m_self;
+    bool                                    renderGlyphs();
+    const CTexture*                         getTexture() const;
 
-    std::string                             getUniqueResourceId();
+    AWP<CLabel>                             m_self;
 
     std::string                             labelPreFormat;
     IWidget::SFormatResult                  label;
@@ -43,11 +47,11 @@ class CLabel : public IWidget {
     Vector2D                                pos;
     Vector2D                                configPos;
     double                                  angle;
-    std::string                             resourceID;
-    std::string                             pendingResourceID; // if dynamic label
+    ResourceID                              resourceID        = 0;
+    ResourceID                              pendingResourceID = 0; // if dynamic label
     std::string                             halign, valign;
     std::string                             onclickCommand;
-    SPreloadedAsset*                        asset = nullptr;
+    SPreloadedAsset*                        asset             = nullptr;
 
     std::string                             outputStringPort;
 
@@ -57,4 +61,13 @@ class CLabel : public IWidget {
 
     CShadowable                             shadow;
     bool                                    updateShadow = true;
+
+    // Labels that update on a timer are drawn from a shared glyph atlas instead of going through the gatherer.
+    // Text the atlas can't draw still falls back to a gatherer request.
+    CGlyphAtlas* glyphAtlas  = nullptr;
+    CFramebuffer glyphFB;
+    bool         glyphsDirty = false;
+    bool         glyphsShown = false;
+    CHyprColor   labelColor;
+    std::string  textAlign;
 };
@@ -86,16 +86,15 @@ void CPasswordInputField::configure(const std::unordered_map<std::string, std::a
     pos = posFromHVAlign(viewport, size->goal(), configPos, halign, valign);
 
     if (!dots.textFormat.empty()) {
-        dots.textResourceID = std::format("input:{}-{}", (uintptr_t)this, dots.textFormat);
         CAsyncResourceGatherer::SPreloadRequest request;
-        request.id                   = dots.textResourceID;
         request.asset                = dots.textFormat;
         request.type                 = CAsyncResourceGatherer::eTargetType::TARGET_TEXT;
         request.props["font_family"] = fontFamily;
         request.props["color"]       = colorConfig.font;
         request.props["font_size"]   = (int)(std::nearbyint(configSize.y * dots.size * 0.5f) * 2.f);
+        request.priority             = CAsyncResourceGatherer::PRIORITY_HIGH;
 
-        g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
+        dots.textResourceID = g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
     }
 
     // request the inital placeholder asset
@@ -111,11 +110,19 @@ void CPasswordInputField::reset() {
     if (g_pHyprlock->m_bTerminate)
         return;
 
-    if (placeholder.asset)
-        g_pRenderer->asyncResourceGatherer->unloadAsset(placeholder.asset);
+    for (const auto& id : placeholder.registeredResourceIDs) {
+        g_pRenderer->asyncResourceGatherer->unloadAsset(id);
+    }
+
+    if (dots.textResourceID)
+        g_pRenderer->asyncResourceGatherer->unloadAsset(dots.textResourceID);
 
-    placeholder.asset = nullptr;
-    placeholder.resourceID.clear();
+    dots.textAsset      = nullptr;
+    dots.textResourceID = 0;
+
+    placeholder.asset      = nullptr;
+    placeholder.resourceID = 0;
+    placeholder.registeredResourceIDs.clear();
     placeholder.currentText.clear();
 }
 
@@ -156,9 +163,6 @@ void CPasswordInputField::updateFade() {
 
     } else if (INPUTUSED && fade.a->goal() != 1.0)
         *fade.a = 1.0;
-
-    if (fade.a->isBeingAnimated())
-        redrawShadow = true;
 }
 
 void CPasswordInputField::updateDots() {
@@ -197,10 +201,16 @@ bool CPasswordInputField::draw(const SRenderData& data) {
     CBox        inputFieldBox = {pos, size->value()};
     CBox        outerBox      = {pos - Vector2D{outThick, outThick}, size->value() + Vector2D{outThick * 2, outThick * 2}};
 
+    // The shadow is rendered from the opaque widget, so it doesn't have to be re-rendered while fading.
+    // Applying the fade twice here looks the same as blurring the faded widget.
+    const float FADEA      = shadow.isRendering() ? 1.f : fade.a->value();
     SRenderData shadowData = data;
-    shadowData.opacity *= fade.a->value();
+    shadowData.opacity *= FADEA * FADEA;
 
-    if (!size->isBeingAnimated())
+    // stretched to the animated size, it is re-rendered once the animation ends
+    if (size->isBeingAnimated())
+        shadow.drawStretched(shadowData);
+    else
         shadow.draw(shadowData);
 
     //CGradientValueData outerGrad = colorState.outer->value();
@@ -208,13 +218,13 @@ bool CPasswordInputField::draw(const SRenderData& data) {
     //    c.a *= fade.a->value() * data.opacity;
 
     CHyprColor innerCol = colorState.inner->value();
-    innerCol.a *= fade.a->value() * data.opacity;
+    innerCol.a *= FADEA * data.opacity;
     CHyprColor fontCol = colorState.font;
-    fontCol.a *= fade.a->value() * data.opacity;
+    fontCol.a *= FADEA * data.opacity;
 
     if (outThick > 0) {
         const auto OUTERROUND = roundingForBorderBox(outerBox, rounding, outThick);
-        g_pRenderer->renderBorder(outerBox, colorState.outer->value(), outThick, OUTERROUND, fade.a->value() * data.opacity);
+        g_pRenderer->renderBorder(outerBox, colorState.outer->value(), outThick, OUTERROUND, FADEA * data.opacity);
 
         if (passwordLength != 0 && !checkWaiting && hiddenInputState.enabled) {
             CBox     outerBoxScaled = outerBox;
@@ -224,11 +234,9 @@ bool CPasswordInputField::draw(const SRenderData& data) {
                 outerBoxScaled.y += outerBoxScaled.h;
             if (hiddenInputState.lastQuadrant % 2 == 1)
                 outerBoxScaled.x += outerBoxScaled.w;
-            glEnable(GL_SCISSOR_TEST);
-            glScissor(outerBoxScaled.x, outerBoxScaled.y, outerBoxScaled.w, outerBoxScaled.h);
-            g_pRenderer->renderBorder(outerBox, hiddenInputState.lastColor, outThick, OUTERROUND, fade.a->value() * data.opacity);
-            glScissor(0, 0, viewport.x, viewport.y);
-            glDisable(GL_SCISSOR_TEST);
+            g_pRenderer->scissor(&outerBoxScaled);
+            g_pRenderer->renderBorder(outerBox, hiddenInputState.lastColor, outThick, OUTERROUND, FADEA * data.opacity);
+            g_pRenderer->scissor(nullptr);
         }
     }
 
@@ -301,7 +309,7 @@ bool CPasswordInputField::draw(const SRenderData& data) {
         }
     }
 
-    if (passwordLength == 0 && !checkWaiting && !placeholder.resourceID.empty()) {
+    if (passwordLength == 0 && !checkWaiting && placeholder.resourceID) {
         SPreloadedAsset* currAsset = nullptr;
 
         if (!placeholder.asset)
@@ -314,25 +322,23 @@ bool CPasswordInputField::draw(const SRenderData& data) {
             const CBox     ASSETBOX{ASSETPOS, currAsset->texture.m_vSize};
 
             // Cut the texture to the width of the input field
-            glEnable(GL_SCISSOR_TEST);
-            glScissor(inputFieldBox.x, inputFieldBox.y, inputFieldBox.w, inputFieldBox.h);
-            g_pRenderer->renderTexture(ASSETBOX, currAsset->texture, data.opacity * fade.a->value(), 0);
-            glScissor(0, 0, viewport.x, viewport.y);
-            glDisable(GL_SCISSOR_TEST);
+            g_pRenderer->scissor(&inputFieldBox);
+            g_pRenderer->renderTexture(ASSETBOX, currAsset->texture, data.opacity * FADEA, 0);
+            g_pRenderer->scissor(nullptr);
         } else
             forceReload = true;
     }
 
-    return redrawShadow || forceReload;
+    return redrawShadow || forceReload || fade.a->isBeingAnimated() || size->isBeingAnimated();
 }
 
 void CPasswordInputField::updatePlaceholder() {
     if (passwordLength != 0) {
         if (placeholder.asset && /* keep prompt asset cause it is likely to be used again */ displayFail) {
             std::erase(placeholder.registeredResourceIDs, placeholder.resourceID);
-            g_pRenderer->asyncResourceGatherer->unloadAsset(placeholder.asset);
+            g_pRenderer->asyncResourceGatherer->unloadAsset(placeholder.resourceID);
             placeholder.asset      = nullptr;
-            placeholder.resourceID = "";
+            placeholder.resourceID = 0;
             redrawShadow           = true;
         }
         return;
@@ -351,35 +357,38 @@ void CPasswordInputField::updatePlaceholder() {
     if (!ALLOWCOLORSWAP && newText == placeholder.currentText)
         return;
 
-    const auto NEWRESOURCEID = std::format("placeholder:{}{}{}{}{}{}", newText, (uintptr_t)this, colorState.font.r, colorState.font.g, colorState.font.b, colorState.font.a);
+    CAsyncResourceGatherer::SPreloadRequest request;
+    request.asset                = newText;
+    request.type                 = CAsyncResourceGatherer::eTargetType::TARGET_TEXT;
+    request.props["font_family"] = fontFamily;
+    request.props["color"]       = colorState.font;
+    request.props["font_size"]   = (int)size->value().y / 4;
+    request.priority             = CAsyncResourceGatherer::PRIORITY_HIGH;
+    request.callback             = [REF = m_self] {
+        if (const auto SELF = REF.lock(); SELF)
+            g_pHyprlock->renderOutput(SELF->outputStringPort);
+    };
+
+    // 0 if nobody requested this text yet
+    const auto EXISTINGID = g_pRenderer->asyncResourceGatherer->findAsset(request);
 
-    if (placeholder.resourceID == NEWRESOURCEID)
+    if (EXISTINGID != 0 && placeholder.resourceID == EXISTINGID)
         return;
 
     Debug::log(TRACE, "Updating placeholder text: {}", newText);
     placeholder.currentText = newText;
     placeholder.asset       = nullptr;
-    placeholder.resourceID  = NEWRESOURCEID;
 
-    if (std::ranges::find(placeholder.registeredResourceIDs, placeholder.resourceID) != placeholder.registeredResourceIDs.end())
+    if (EXISTINGID != 0 && std::ranges::find(placeholder.registeredResourceIDs, EXISTINGID) != placeholder.registeredResourceIDs.end()) {
+        placeholder.resourceID = EXISTINGID;
         return;
+    }
 
-    Debug::log(TRACE, "Requesting new placeholder asset: {}", placeholder.resourceID);
+    // query
+    placeholder.resourceID = g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
     placeholder.registeredResourceIDs.push_back(placeholder.resourceID);
 
-    // query
-    CAsyncResourceGatherer::SPreloadRequest request;
-    request.id                   = placeholder.resourceID;
-    request.asset                = placeholder.currentText;
-    request.type                 = CAsyncResourceGatherer::eTargetType::TARGET_TEXT;
-    request.props["font_family"] = fontFamily;
-    request.props["color"]       = colorState.font;
-    request.props["font_size"]   = (int)size->value().y / 4;
-    request.callback             = [REF = m_self] {
-        if (const auto SELF = REF.lock(); SELF)
-            g_pHyprlock->renderOutput(SELF->outputStringPort);
-    };
-    g_pRenderer->asyncResourceGatherer->requestAsyncAssetPreload(request);
+    Debug::log(TRACE, "Requested new placeholder asset: {}", placeholder.resourceID);
 }
 
 void CPasswordInputField::updateWidth() {
@@ -398,10 +407,8 @@ void CPasswordInputField::updateWidth() {
         });
     }
 
-    if (size->isBeingAnimated()) {
-        redrawShadow = true;
-        pos          = posFromHVAlign(viewport, size->value(), configPos, halign, valign);
-    }
+    if (size->isBeingAnimated())
+        pos = posFromHVAlign(viewport, size->value(), configPos, halign, valign);
 }
 
 void CPasswordInputField::updateHiddenInputState() {
@@ -7,6 +7,7 @@
 #include "Shadowable.hpp"
 #include "../../config/ConfigDataValues.hpp"
 #include "../../helpers/AnimatedVariable.hpp"
+#include "../Shared.hpp"
 #include <hyprutils/math/Vector2D.hpp>
 #include <vector>
 #include <any>
@@ -60,13 +61,13 @@ class CPasswordInputField : public IWidget {
 
     struct {
         PHLANIMVAR<float> currentAmount;
-        bool              center     = false;
-        float             size       = 0;
-        float             spacing    = 0;
-        int               rounding   = 0;
-        std::string       textFormat = "";
-        std::string       textResourceID;
-        SPreloadedAsset*  textAsset = nullptr;
+        bool              center         = false;
+        float             size           = 0;
+        float             spacing        = 0;
+        int               rounding       = 0;
+        std::string       textFormat     = "";
+        ResourceID        textResourceID = 0;
+        SPreloadedAsset*  textAsset      = nullptr;
     } dots;
 
     struct {
@@ -77,13 +78,13 @@ class CPasswordInputField : public IWidget {
     } fade;
 
     struct {
-        std::string              resourceID = "";
+        ResourceID               resourceID = 0;
         SPreloadedAsset*         asset      = nullptr;
 
         std::string              currentText    = "";
         size_t                   failedAttempts = 0;
 
-        std::vector<std::string> registeredResourceIDs;
+        std::vector<ResourceID>  registeredResourceIDs;
     } placeholder;
 
     struct {
@@ -1,6 +1,10 @@
 #include "Shadowable.hpp"
 #include "../Renderer.hpp"
 #include <hyprlang.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <optional>
 
 void CShadowable::configure(AWP<IWidget> widget_, const std::unordered_map<std::string, std::any>& props, const Vector2D& viewport_) {
     m_widget = widget_;
@@ -10,6 +14,15 @@ void CShadowable::configure(AWP<IWidget> widget_, const std::unordered_map<std::
     passes = std::any_cast<Hyprlang::INT>(props.at("shadow_passes"));
     color  = std::any_cast<Hyprlang::INT>(props.at("shadow_color"));
     boostA = std::any_cast<Hyprlang::FLOAT>(props.at("shadow_boost"));
+
+    if (props.contains("rotate"))
+        angle = std::any_cast<Hyprlang::FLOAT>(props.at("rotate")) * M_PI / 180.0;
+
+    // borders can be on either side of the bounding box, plus a pixel of anti-aliasing for rotated widgets
+    for (const auto KEY : {"border_size", "outline_thickness"}) {
+        if (props.contains(KEY))
+            padding = std::max<int>(padding, std::any_cast<Hyprlang::INT>(props.at(KEY)) * 2 + 2);
+    }
 }
 
 void CShadowable::markShadowDirty() {
@@ -21,10 +34,28 @@ void CShadowable::markShadowDirty() {
     if (passes == 0)
         return;
 
-    if (!shadowFB.isAllocated())
-        shadowFB.alloc(viewport.x, viewport.y, true);
+    CBox box = widgetBox();
+    if (box.empty())
+        return;
+
+    renderedWidgetBox = box;
+
+    if (angle != 0) {
+        const auto   MIDDLE = box.middle();
+        const double W      = std::abs(box.w * std::cos(angle)) + std::abs(box.h * std::sin(angle));
+        const double H      = std::abs(box.w * std::sin(angle)) + std::abs(box.h * std::cos(angle));
+        box                 = {MIDDLE.x - W / 2.0, MIDDLE.y - H / 2.0, W, H};
+    }
+
+    // nothing outside of the viewport is ever shown
+    box = box.expand(g_pRenderer->blurSpread(size, passes) + padding).intersection({0, 0, viewport.x, viewport.y}).round();
+    if (box.empty())
+        return;
+
+    shadowBox = box;
+    shadowFB.alloc(box.w, box.h, true);
 
-    g_pRenderer->pushFb(shadowFB.m_iFb);
+    g_pRenderer->pushFb(shadowFB.m_iFb, box.pos());
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glClear(GL_COLOR_BUFFER_BIT);
 
@@ -37,6 +68,20 @@ void CShadowable::markShadowDirty() {
     g_pRenderer->popFb();
 }
 
+CBox CShadowable::widgetBox() const {
+    const auto WIDGET = m_widget.lock();
+    if (!WIDGET)
+        return {};
+
+    // the bounding box is top down, drawing is bottom up
+    const auto WLBOX = WIDGET->getBoundingBoxWl();
+    return {WLBOX.x, viewport.y - WLBOX.y - WLBOX.h, WLBOX.w, WLBOX.h};
+}
+
+bool CShadowable::isRendering() const {
+    return ignoreDraw;
+}
+
 bool CShadowable::draw(const IWidget::SRenderData& data) {
     if (!m_widget || passes == 0)
         return true;
@@ -44,7 +89,79 @@ bool CShadowable::draw(const IWidget::SRenderData& data) {
     if (!shadowFB.isAllocated() || ignoreDraw)
         return true;
 
-    CBox box = {0, 0, viewport.x, viewport.y};
-    g_pRenderer->renderTexture(box, shadowFB.m_cTex, data.opacity, 0, HYPRUTILS_TRANSFORM_NORMAL);
+    g_pRenderer->renderTexture(shadowBox, shadowFB.m_cTex, data.opacity, 0, HYPRUTILS_TRANSFORM_NORMAL);
+    return true;
+}
+
+// Where one axis of the shadow texture goes. Drawn with dst = src * scale + offset, clipped to clip0..clip1.
+struct SShadowSpan {
+    double clip0 = 0, clip1 = 0;
+    double scale = 1, offset = 0;
+};
+
+// Edges move with the widget's edges, the middle is stretched in between
+static std::optional<std::array<SShadowSpan, 3>> splitShadowAxis(double shadow0, double shadow1, double old0, double old1, double new0, double new1, double edge) {
+    edge = std::min(edge, (old1 - old0) / 2.0 - 1.0);
+    if (edge < 0)
+        return std::nullopt;
+
+    const double LEFT  = new0 + edge;
+    const double RIGHT = new1 - edge;
+
+    std::array<SShadowSpan, 3> spans = {{
+        {.clip0 = shadow0 + new0 - old0, .clip1 = LEFT, .offset = new0 - old0},
+        {.clip0 = LEFT, .clip1 = RIGHT},
+        {.clip0 = RIGHT, .clip1 = shadow1 + new1 - old1, .offset = new1 - old1},
+    }};
+
+    spans[1].scale  = (RIGHT - LEFT) / ((old1 - edge) - (old0 + edge));
+    spans[1].offset = LEFT - (old0 + edge) * spans[1].scale;
+
+    // narrower than both edges, they meet in the middle
+    if (RIGHT < LEFT) {
+        const double MIDDLE = (LEFT + RIGHT) / 2.0;
+        spans[0].clip1      = MIDDLE;
+        spans[1].clip1      = spans[1].clip0;
+        spans[2].clip0      = MIDDLE;
+    }
+
+    return spans;
+}
+
+bool CShadowable::drawStretched(const IWidget::SRenderData& data) {
+    if (!m_widget || passes == 0)
+        return true;
+
+    if (!shadowFB.isAllocated() || ignoreDraw)
+        return true;
+
+    const auto BOX = widgetBox();
+    if (angle != 0 || BOX.empty() || (BOX.pos() == renderedWidgetBox.pos() && BOX.size() == renderedWidgetBox.size()))
+        return draw(data);
+
+    // the blur and rounded corners make everything this close to an edge uneven
+    const double EDGE   = g_pRenderer->blurSpread(size, passes) + padding + std::min(renderedWidgetBox.w, renderedWidgetBox.h) / 2.0;
+    const auto&  OLDBOX = renderedWidgetBox;
+
+    const auto   XSPANS = splitShadowAxis(shadowBox.x, shadowBox.x + shadowBox.w, OLDBOX.x, OLDBOX.x + OLDBOX.w, BOX.x, BOX.x + BOX.w, EDGE);
+    const auto   YSPANS = splitShadowAxis(shadowBox.y, shadowBox.y + shadowBox.h, OLDBOX.y, OLDBOX.y + OLDBOX.h, BOX.y, BOX.y + BOX.h, EDGE);
+    if (!XSPANS || !YSPANS)
+        return draw(data);
+
+    for (const auto& X : *XSPANS) {
+        for (const auto& Y : *YSPANS) {
+            if (X.clip1 <= X.clip0 || Y.clip1 <= Y.clip0)
+                continue;
+
+            // rounded the same way on both sides, so neighboring pieces neither overlap nor leave gaps
+            const CBox CLIP   = {std::round(X.clip0), std::round(Y.clip0), std::round(X.clip1) - std::round(X.clip0), std::round(Y.clip1) - std::round(Y.clip0)};
+            const CBox TEXBOX = {shadowBox.x * X.scale + X.offset, shadowBox.y * Y.scale + Y.offset, shadowBox.w * X.scale, shadowBox.h * Y.scale};
+
+            g_pRenderer->scissor(&CLIP);
+            g_pRenderer->renderTexture(TEXBOX, shadowFB.m_cTex, data.opacity, 0, HYPRUTILS_TRANSFORM_NORMAL);
+        }
+    }
+
+    g_pRenderer->scissor(nullptr);
     return true;
 }
@@ -13,22 +13,38 @@ class CShadowable {
   public:
     virtual ~CShadowable() = default;
     CShadowable()          = default;
-    void configure(AWP<IWidget> widget_, const std::unordered_map<std::string, std::any>& props, const Vector2D& viewport_ /* TODO: make this not the entire viewport */);
+    void configure(AWP<IWidget> widget_, const std::unordered_map<std::string, std::any>& props, const Vector2D& viewport_);
 
-    // instantly re-renders the shadow using the widget's draw() method
+    // Instantly re-renders the shadow using the widget's draw() method.
+    // Only the widget's bounding box and the blur around it are rendered, so the widget has to be positioned already.
     void         markShadowDirty();
     virtual bool draw(const IWidget::SRenderData& data);
 
+    /* Draws the last rendered shadow fitted to the widget's current bounding box.
+       The edges keep their size and only the middle is stretched, so a widget can animate its size without re-rendering the shadow every frame.
+       Falls back to draw() for rotated widgets. */
+    bool         drawStretched(const IWidget::SRenderData& data);
+
+    // true while the widget is drawn into the shadow
+    bool         isRendering() const;
+
   private:
+    // in surface coordinates, without rotation
+    CBox         widgetBox() const;
+
     AWP<IWidget> m_widget;
     int          size   = 10;
     int          passes = 4;
     float        boostA = 1.0;
     CHyprColor   color{0, 0, 0, 1.0};
     Vector2D     viewport;
+    float        angle   = 0;
+    int          padding = 0; // drawn outside of the bounding box, like borders
 
     // to avoid recursive shadows
     bool         ignoreDraw = false;
 
     CFramebuffer shadowFB;
+    CBox         shadowBox;         // what shadowFB covers, in surface coordinates
+    CBox         renderedWidgetBox; // widgetBox() when shadowFB was rendered
 };
@@ -68,11 +68,10 @@ bool CShape::draw(const SRenderData& data) {
             g_pRenderer->renderBorder(borderBox, borderGrad, border, rounding == -1 ? PIROUND : std::clamp(rounding, 0, PIROUND), data.opacity);
         }
 
-        glEnable(GL_SCISSOR_TEST);
-        glScissor(shapeBox.x, shapeBox.y, shapeBox.width, shapeBox.height);
+        g_pRenderer->scissor(&shapeBox);
         glClearColor(0.0, 0.0, 0.0, 0.0);
         glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_SCISSOR_TEST);
+        g_pRenderer->scissor(nullptr);
 
         return data.opacity < 1.0;
     }